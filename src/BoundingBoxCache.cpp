@@ -0,0 +1,53 @@
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/usdGeom/imageable.h>
+
+#include "BoundingBoxCache.h"
+
+BoundingBoxCache::BoundingBoxCache() : _cache(UsdTimeCode::Default(), UsdGeomImageable::GetOrderedPurposeTokens()) {}
+
+BoundingBoxCache::~BoundingBoxCache() { TfNotice::Revoke(_objectsChangedKey); }
+
+UsdGeomBBoxCache &BoundingBoxCache::GetCache(const UsdStageRefPtr &stage, UsdTimeCode timeCode) {
+    if (!_stage || get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _cache.Clear();
+        _stage = stage;
+        if (stage) {
+            _objectsChangedKey =
+                TfNotice::Register(TfCreateWeakPtr(this), &BoundingBoxCache::OnObjectsChanged, UsdStageWeakPtr(stage));
+        }
+    }
+    // SetTime keeps the bounds if the time code is the same
+    _cache.SetTime(timeCode);
+    return _cache;
+}
+
+// The bounds depend on the transforms, extents, visibility and purpose of the prims and on the composition, so any
+// change of the stage clears the cache. The bounds are computed again only when they are queried.
+void BoundingBoxCache::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    _cache.Clear();
+    _invalidationCount++;
+}
+
+GfBBox3d BoundingBoxCache::ComputeWorldBound(const UsdStageRefPtr &stage, const SdfPath &path, UsdTimeCode timeCode) {
+    TRACE_FUNCTION();
+    if (!stage)
+        return {};
+    const UsdPrim prim = stage->GetPrimAtPath(path);
+    return prim ? GetCache(stage, timeCode).ComputeWorldBound(prim) : GfBBox3d();
+}
+
+GfBBox3d BoundingBoxCache::ComputeWorldBound(const UsdStageRefPtr &stage, const SdfPathVector &paths, UsdTimeCode timeCode) {
+    GfBBox3d bbox;
+    for (const SdfPath &path : paths) {
+        bbox = GfBBox3d::Combine(ComputeWorldBound(stage, path, timeCode), bbox);
+    }
+    return bbox;
+}
+
+GfBBox3d BoundingBoxCache::ComputeStageBound(const UsdStageRefPtr &stage, UsdTimeCode timeCode) {
+    if (!stage)
+        return {};
+    const UsdPrim defaultPrim = stage->GetDefaultPrim();
+    return ComputeWorldBound(stage, defaultPrim ? defaultPrim.GetPath() : SdfPath::AbsoluteRootPath(), timeCode);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// World bounds of the prims of a stage at a time code, shared by the viewports for framing and picking.
+/// The bounds are computed on demand and kept until the stage is changed. UsdGeomBBoxCache resolves the children
+/// of a prim in parallel, so computing the bound of the stage populates the bounds of all its prims.
+///
+class BoundingBoxCache : public TfWeakBase {
+  public:
+    BoundingBoxCache();
+    ~BoundingBoxCache();
+
+    // Delete copy
+    BoundingBoxCache(const BoundingBoxCache &) = delete;
+    BoundingBoxCache &operator=(const BoundingBoxCache &) = delete;
+
+    /// World bound of the prim at path. The cache is reset when the stage or the time code differ from the last call.
+    GfBBox3d ComputeWorldBound(const UsdStageRefPtr &stage, const SdfPath &path, UsdTimeCode timeCode);
+
+    /// Combined world bound of the prims
+    GfBBox3d ComputeWorldBound(const UsdStageRefPtr &stage, const SdfPathVector &paths, UsdTimeCode timeCode);
+
+    /// World bound of the default prim, or of the whole stage when there is no default prim
+    GfBBox3d ComputeStageBound(const UsdStageRefPtr &stage, UsdTimeCode timeCode);
+
+    /// Number of times the cache was cleared by a stage change, for debugging
+    size_t GetInvalidationCount() const { return _invalidationCount; }
+
+  private:
+    UsdGeomBBoxCache &GetCache(const UsdStageRefPtr &stage, UsdTimeCode timeCode);
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    UsdGeomBBoxCache _cache;
+    size_t _invalidationCount = 0;
+};
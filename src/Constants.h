@@ -16,6 +16,13 @@ constexpr float TableRowDefaultHeight = 22.f;
 /// Waiting time before a tooltip shows up
 constexpr float TimeBeforeTooltip = 2.f; // 2 seconds
 
+/// Frames drawn after an input before the main loop waits for the next event, ImGui needs a few frames to update the
+/// hovered and opened widgets
+constexpr int FramesDrawnAfterInput = 3;
+
+/// Longest wait for an event when the editor is idle, the results of the background tasks are shown at this interval
+constexpr double IdleEventsTimeout = 0.25; // seconds
+
 /// Predefined colors for the different widgets
 #define ColorAttributeAuthored {1.0, 1.0, 1.0, 1.0}
 #define ColorAttributeUnauthored {0.5, 0.5, 0.5, 1.0}
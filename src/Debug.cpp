@@ -1,10 +1,30 @@
+#include "BoundingVolumeHierarchy.h"
+#include "Commands.h"
 #include "Debug.h"
+#include "FrameStatistics.h"
 #include "Gui.h"
+#include "SdfCommandGroup.h"
+#include "SdfCommandGroupRecorder.h"
+#include "SdfLayerDiff.h"
+#include "Selection.h"
+#include "ViewportViewState.h"
 #include "pxr/base/trace/reporter.h"
 #include "pxr/base/trace/trace.h"
 #include <pxr/base/plug/plugin.h>
 #include <pxr/base/plug/registry.h>
 #include <pxr/base/tf/debug.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/attributeSpec.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/editContext.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
 #include <sstream>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -73,16 +93,364 @@ static void DrawPlugins() {
     }
 }
 
+using BenchmarkClock = std::chrono::steady_clock;
+
+static double GetElapsedMilliseconds(BenchmarkClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+// Time the stage selection operations on pathCount paths
+static std::string RunSelectionBenchmark(int pathCount) {
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    UsdStageWeakPtr stageWeak(stage);
+    SdfPathVector paths;
+    paths.reserve(pathCount);
+    for (int i = 0; i < pathCount; ++i) {
+        paths.emplace_back(TfStringPrintf("/Root/Group_%d/Prim_%d", i / 1000, i));
+    }
+    Selection selection;
+    std::string report;
+
+    auto start = BenchmarkClock::now();
+    for (const auto &path : paths) {
+        selection.AddSelected(stage, path);
+    }
+    report += TfStringPrintf("AddSelected: %.3f ms\n", GetElapsedMilliseconds(start));
+
+    start = BenchmarkClock::now();
+    size_t selectedCount = 0;
+    for (const auto &path : paths) {
+        selectedCount += selection.IsSelected(stageWeak, path) ? 1 : 0;
+    }
+    report += TfStringPrintf("IsSelected: %.3f ms (%zu selected)\n", GetElapsedMilliseconds(start), selectedCount);
+
+    SelectionHash lastSelectionHash = 0;
+    selection.UpdateSelectionHash(stage, lastSelectionHash);
+    start = BenchmarkClock::now();
+    size_t changeCount = 0;
+    for (int i = 0; i < pathCount; ++i) {
+        changeCount += selection.UpdateSelectionHash(stage, lastSelectionHash) ? 1 : 0;
+    }
+    report += TfStringPrintf("UpdateSelectionHash x %d: %.3f ms (%zu changes)\n", pathCount, GetElapsedMilliseconds(start),
+                             changeCount);
+
+    start = BenchmarkClock::now();
+    const auto selectedPaths = selection.GetSelectedPaths(stage);
+    report += TfStringPrintf("GetSelectedPaths: %.3f ms (%zu paths)\n", GetElapsedMilliseconds(start), selectedPaths.size());
+
+    start = BenchmarkClock::now();
+    const int removedCount = std::min(pathCount, 1000);
+    for (int i = 0; i < removedCount; ++i) {
+        selection.RemoveSelected(stage, paths[i * (pathCount / removedCount)]);
+    }
+    report += TfStringPrintf("RemoveSelected x %d: %.3f ms\n", removedCount, GetElapsedMilliseconds(start));
+
+    start = BenchmarkClock::now();
+    selection.Clear(stage);
+    report += TfStringPrintf("Clear: %.3f ms\n", GetElapsedMilliseconds(start));
+    return report;
+}
+
+// Time the undo and redo of a group of at least instructionCount instructions creating a hierarchy, like a paste.
+// The undo is timed with all the instructions replayed and with the instructions on the created specs skipped.
+static std::string RunUndoBenchmark(int instructionCount) {
+    SdfLayerRefPtr layer = SdfLayer::CreateAnonymous("benchmark.usda");
+    SdfCommandGroup group;
+    std::string report;
+
+    auto start = BenchmarkClock::now();
+    {
+        SdfCommandGroupRecorder recorder(group, layer);
+        SdfChangeBlock block;
+        SdfPrimSpecHandle root = SdfPrimSpec::New(layer, "Root", SdfSpecifierDef, "Xform");
+        for (int i = 0; group.GetInstructionCount() < static_cast<size_t>(instructionCount); ++i) {
+            SdfPrimSpecHandle prim = SdfPrimSpec::New(root, TfStringPrintf("Prim_%d", i), SdfSpecifierDef, "Mesh");
+            SdfAttributeSpecHandle attribute = SdfAttributeSpec::New(prim, "size", SdfValueTypeNames->Double);
+            attribute->SetDefaultValue(VtValue(static_cast<double>(i)));
+        }
+    }
+    report += TfStringPrintf("Record: %.3f ms (%zu instructions)\n", GetElapsedMilliseconds(start),
+                             group.GetInstructionCount());
+
+    start = BenchmarkClock::now();
+    group.UndoIt(false);
+    report += TfStringPrintf("Undo all instructions: %.3f ms (%zu root prims left)\n", GetElapsedMilliseconds(start),
+                             layer->GetRootPrims().size());
+
+    start = BenchmarkClock::now();
+    group.DoIt();
+    report += TfStringPrintf("Redo: %.3f ms\n", GetElapsedMilliseconds(start));
+
+    start = BenchmarkClock::now();
+    group.UndoIt();
+    report += TfStringPrintf("Undo skipping created specs: %.3f ms (%zu root prims left)\n", GetElapsedMilliseconds(start),
+                             layer->GetRootPrims().size());
+    return report;
+}
+
+// Record edits on the root layer, a sublayer and the session layer of a stage, and check that undo and redo
+// restore exactly the content of the three layers
+static std::string RunMultiLayerUndoCheck() {
+    SdfLayerRefPtr subLayer = SdfLayer::CreateAnonymous("sublayer.usda");
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    stage->GetRootLayer()->InsertSubLayerPath(subLayer->GetIdentifier());
+    stage->DefinePrim(SdfPath("/Root"), TfToken("Xform"));
+    const SdfLayerHandleVector layers = {stage->GetRootLayer(), subLayer, stage->GetSessionLayer()};
+    const auto exportLayers = [&layers]() {
+        std::vector<std::string> contents(layers.size());
+        for (size_t i = 0; i < layers.size(); ++i) {
+            layers[i]->ExportToString(&contents[i]);
+        }
+        return contents;
+    };
+
+    const auto before = exportLayers();
+    SdfCommandGroup group;
+    {
+        SdfCommandGroupRecorder recorder(group, stage);
+        stage->GetPrimAtPath(SdfPath("/Root")).CreateAttribute(TfToken("size"), SdfValueTypeNames->Double).Set(2.0);
+        {
+            UsdEditContext context(stage, subLayer);
+            stage->DefinePrim(SdfPath("/Root/InSubLayer"), TfToken("Sphere"))
+                .CreateAttribute(TfToken("radius"), SdfValueTypeNames->Double)
+                .Set(3.0);
+        }
+        {
+            UsdEditContext context(stage, stage->GetSessionLayer());
+            stage->OverridePrim(SdfPath("/Root/InSubLayer")).SetDocumentation("session");
+        }
+    }
+    const auto after = exportLayers();
+
+    std::string report = TfStringPrintf("Recorded %zu instructions\n", group.GetInstructionCount());
+    const auto check = [&](const char *step, const std::vector<std::string> &expected) {
+        const auto contents = exportLayers();
+        for (size_t i = 0; i < layers.size(); ++i) {
+            report += TfStringPrintf("%s %s: %s\n", step, layers[i]->GetDisplayName().c_str(),
+                                     contents[i] == expected[i] ? "ok" : "FAILED");
+        }
+    };
+    group.UndoIt();
+    check("Undo", before);
+    group.DoIt();
+    check("Redo", after);
+    group.UndoIt(false);
+    check("Undo all instructions", before);
+    return report;
+}
+
+// Compare the text edit of one value in a layer of primCount prims, applied by reloading the whole layer and keeping
+// the texts for the undo, and applied by writing the differences
+static std::string RunTextEditBenchmark(int primCount) {
+    SdfLayerRefPtr layer = SdfLayer::CreateAnonymous("benchmark.usda");
+    {
+        SdfChangeBlock block;
+        for (int i = 0; i < primCount; ++i) {
+            SdfPrimSpecHandle prim = SdfPrimSpec::New(layer, TfStringPrintf("Prim_%d", i), SdfSpecifierDef, "Xform");
+            SdfAttributeSpecHandle attribute = SdfAttributeSpec::New(prim, "size", SdfValueTypeNames->Double);
+            attribute->SetDefaultValue(VtValue(static_cast<double>(i)));
+        }
+    }
+    std::string text;
+    layer->ExportToString(&text);
+    std::string newText = text;
+    const std::string editedValue = "double size = 0";
+    const size_t editPosition = newText.find(editedValue);
+    if (editPosition == std::string::npos)
+        return "Unable to find the edited value\n";
+    newText.replace(editPosition, editedValue.size(), "double size = -1");
+    std::string report;
+
+    auto start = BenchmarkClock::now();
+    std::string oldText;
+    layer->ExportToString(&oldText);
+    layer->ImportFromString(newText);
+    report += TfStringPrintf("Import whole layer: %.3f ms, undo memory %.1f KB\n", GetElapsedMilliseconds(start),
+                             (oldText.size() + newText.size()) / 1024.0);
+    start = BenchmarkClock::now();
+    layer->ImportFromString(oldText);
+    report += TfStringPrintf("Undo import whole layer: %.3f ms\n", GetElapsedMilliseconds(start));
+
+    start = BenchmarkClock::now();
+    SdfCommandGroup group;
+    {
+        SdfLayerRefPtr scratchLayer = SdfLayer::CreateAnonymous("text.usda");
+        scratchLayer->ImportFromString(newText);
+        SdfCommandGroupRecorder recorder(group, layer);
+        ApplyLayerDifferences(scratchLayer, layer);
+    }
+    report += TfStringPrintf("Apply differences: %.3f ms, undo memory %.1f KB (%zu instructions)\n",
+                             GetElapsedMilliseconds(start), group.GetMemoryFootprint() / 1024.0, group.GetInstructionCount());
+    start = BenchmarkClock::now();
+    group.UndoIt();
+    report += TfStringPrintf("Undo differences: %.3f ms\n", GetElapsedMilliseconds(start));
+    std::string undoneText;
+    layer->ExportToString(&undoneText);
+    report += TfStringPrintf("Undone layer identical to the original: %s\n", undoneText == text ? "yes" : "NO");
+    return report;
+}
+
+// Pick a stage of gprimCount cubes on a grid with the bounding volume hierarchy, and compare the rays with a test of
+// all the bounds. The hydra picking can't be timed here as it needs a renderer.
+static std::string RunPickingBenchmark(int gprimCount) {
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    const int side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(gprimCount))));
+    const double spacing = 3.0;
+    SdfPathVector paths;
+    {
+        SdfChangeBlock block;
+        SdfLayerHandle layer = stage->GetRootLayer();
+        SdfPrimSpecHandle root = SdfPrimSpec::New(layer, "Root", SdfSpecifierDef, "Xform");
+        SdfPrimSpecHandle group;
+        for (int i = 0; i < gprimCount; ++i) {
+            if (i % 1000 == 0) {
+                group = SdfPrimSpec::New(root, TfStringPrintf("Group_%d", i / 1000), SdfSpecifierDef, "Xform");
+            }
+            SdfPrimSpecHandle cube = SdfPrimSpec::New(group, TfStringPrintf("Cube_%d", i), SdfSpecifierDef, "Cube");
+            SdfAttributeSpecHandle translate = SdfAttributeSpec::New(cube, "xformOp:translate", SdfValueTypeNames->Double3);
+            translate->SetDefaultValue(
+                VtValue(GfVec3d(i % side, (i / side) % side, i / (side * side)) * spacing));
+            SdfAttributeSpecHandle xformOpOrder =
+                SdfAttributeSpec::New(cube, "xformOpOrder", SdfValueTypeNames->TokenArray, SdfVariabilityUniform);
+            xformOpOrder->SetDefaultValue(VtValue(VtTokenArray{TfToken("xformOp:translate")}));
+            paths.push_back(cube->GetPath());
+        }
+    }
+    BoundingBoxCache boundingBoxCache;
+    BoundingVolumeHierarchy hierarchy;
+    const TfTokenVector purposes = {UsdGeomTokens->default_};
+    std::string report;
+
+    auto start = BenchmarkClock::now();
+    hierarchy.Update(stage, UsdTimeCode::Default(), purposes, boundingBoxCache);
+    report += TfStringPrintf("Build: %.3f ms (%zu prims, %zu nodes)\n", GetElapsedMilliseconds(start), hierarchy.GetPrimCount(),
+                             hierarchy.GetNodeCount());
+
+    // Rays from a point outside the grid to random cubes
+    const int rayCount = 1000;
+    const double gridSize = side * spacing;
+    const GfVec3d origin(-gridSize, -gridSize, -gridSize);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> pathDistribution(0, gprimCount - 1);
+    std::vector<GfRay> rays;
+    for (int i = 0; i < rayCount; ++i) {
+        const GfVec3d target = boundingBoxCache.ComputeWorldBound(stage, paths[pathDistribution(generator)], UsdTimeCode::Default())
+                                   .ComputeCentroid();
+        rays.emplace_back(origin, (target - origin).GetNormalized());
+    }
+    start = BenchmarkClock::now();
+    SdfPathVector hits(rayCount);
+    for (int i = 0; i < rayCount; ++i) {
+        hierarchy.IntersectRay(rays[i], hits[i]);
+    }
+    report += TfStringPrintf("Bvh rays x %d: %.3f ms\n", rayCount, GetElapsedMilliseconds(start));
+
+    std::vector<std::pair<SdfPath, GfBBox3d>> bounds;
+    for (const SdfPath &path : paths) {
+        bounds.emplace_back(path, boundingBoxCache.ComputeWorldBound(stage, path, UsdTimeCode::Default()));
+    }
+    const int bruteForceRayCount = std::min(rayCount, 100);
+    int matchCount = 0;
+    start = BenchmarkClock::now();
+    for (int i = 0; i < bruteForceRayCount; ++i) {
+        SdfPath closestPath;
+        double closestDistance = std::numeric_limits<double>::max();
+        for (const auto &bound : bounds) {
+            double enterDistance = 0.0;
+            double exitDistance = 0.0;
+            if (rays[i].Intersect(bound.second, &enterDistance, &exitDistance) && enterDistance < closestDistance) {
+                closestDistance = enterDistance;
+                closestPath = bound.first;
+            }
+        }
+        matchCount += closestPath == hits[i] ? 1 : 0;
+    }
+    report += TfStringPrintf("All bounds rays x %d: %.3f ms (%d/%d same hits as the bvh)\n", bruteForceRayCount,
+                             GetElapsedMilliseconds(start), matchCount, bruteForceRayCount);
+
+    GfFrustum frustum;
+    frustum.SetPosition(origin);
+    frustum.SetRotation(GfRotation(GfVec3d(0.0, 0.0, -1.0), GfVec3d(1.0, 1.0, 1.0)));
+    frustum.SetPerspective(10.0, 1.0, 1.0, 10.0 * gridSize);
+    start = BenchmarkClock::now();
+    const SdfPathVector inFrustum = hierarchy.IntersectFrustum(frustum);
+    report += TfStringPrintf("Frustum: %.3f ms (%zu prims)\n", GetElapsedMilliseconds(start), inFrustum.size());
+
+    // Moving one cube refits the hierarchy instead of rebuilding it
+    stage->GetPrimAtPath(paths[0]).GetAttribute(TfToken("xformOp:translate")).Set(GfVec3d(-spacing));
+    start = BenchmarkClock::now();
+    hierarchy.Update(stage, UsdTimeCode::Default(), purposes, boundingBoxCache);
+    report += TfStringPrintf("Refit after moving a cube: %.3f ms (%zu builds, %zu refits)\n", GetElapsedMilliseconds(start),
+                             hierarchy.GetBuildCount(), hierarchy.GetRefitCount());
+    return report;
+}
+
+static void DrawBenchmarks() {
+    static int pathCount = 100000;
+    static std::string selectionReport;
+    ImGui::InputInt("Selected paths", &pathCount);
+    ImGui::SameLine();
+    if (ImGui::Button("Run selection benchmark")) {
+        selectionReport = RunSelectionBenchmark(std::max(pathCount, 1));
+    }
+    ImGui::TextUnformatted(selectionReport.c_str());
+
+    static int instructionCount = 100000;
+    static std::string undoReport;
+    ImGui::InputInt("Undo instructions", &instructionCount);
+    ImGui::SameLine();
+    if (ImGui::Button("Run undo benchmark")) {
+        undoReport = RunUndoBenchmark(std::max(instructionCount, 1));
+    }
+    ImGui::TextUnformatted(undoReport.c_str());
+
+    static int primCount = 100000;
+    static std::string textEditReport;
+    ImGui::InputInt("Layer prims", &primCount);
+    ImGui::SameLine();
+    if (ImGui::Button("Run text edit benchmark")) {
+        textEditReport = RunTextEditBenchmark(std::max(primCount, 1));
+    }
+    ImGui::TextUnformatted(textEditReport.c_str());
+
+    static int gprimCount = 100000;
+    static std::string pickingReport;
+    ImGui::InputInt("Gprims", &gprimCount);
+    ImGui::SameLine();
+    if (ImGui::Button("Run picking benchmark")) {
+        pickingReport = RunPickingBenchmark(std::max(gprimCount, 1));
+    }
+    ImGui::TextUnformatted(pickingReport.c_str());
+
+    static std::string multiLayerReport;
+    if (ImGui::Button("Run multi-layer undo check")) {
+        multiLayerReport = RunMultiLayerUndoCheck();
+    }
+    ImGui::TextUnformatted(multiLayerReport.c_str());
+}
+
 // Draw a preference like panel
 void DrawDebugUI() {
-    static const char *const panels[] = {"Timings", "Debug codes", "Trace reporter", "Plugins"};
+    static const char *const panels[] = {"Timings", "Debug codes", "Trace reporter", "Plugins", "Benchmarks"};
     static int current_item = 0;
     ImGui::PushItemWidth(100);
-    ImGui::ListBox("##DebugPanels", &current_item, panels, 4);
+    ImGui::ListBox("##DebugPanels", &current_item, panels, 5);
     ImGui::SameLine();
     if (current_item == 0) {
         ImGui::BeginChild("##Timing");
         ImGui::Text("ImGui: %.3f ms/frame  (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::Text("Undo stack: %zu commands, %.1f KB", GetUndoStackSize(), GetUndoStackMemoryFootprint() / 1024.0);
+        ImGui::Text("Last undo/redo: %.3f ms", GetLastUndoRedoMilliseconds());
+        // Each read of the view state used to compute the camera, its frustum and its matrices
+        const ViewStateStatistics &viewState = GetViewStateStatistics();
+        const double computeAverage =
+            viewState.computeCount ? viewState.computeMilliseconds / static_cast<double>(viewState.computeCount) : 0.0;
+        const size_t savedCount = viewState.readCount > viewState.computeCount ? viewState.readCount - viewState.computeCount : 0;
+        ImGui::Text("View states: %zu computed, %zu read, %.3f ms saved", viewState.computeCount, viewState.readCount,
+                    static_cast<double>(savedCount) * computeAverage);
+        const FrameStatistics &frames = GetFrameStatistics();
+        ImGui::Text("Frames: %zu drawn, %zu idle waits", frames.drawnFrames, frames.idleWaits);
+        ImGui::Text("Viewport frames: %zu rendered, %zu skipped", frames.renderedViewportFrames, frames.skippedViewportFrames);
         ImGui::EndChild();
     } else if (current_item == 1) {
         ImGui::BeginChild("##DebugCodes");
@@ -96,5 +464,9 @@ void DrawDebugUI() {
         ImGui::BeginChild("##Plugins");
         DrawPlugins();
         ImGui::EndChild();
+    } else if (current_item == 4) {
+        ImGui::BeginChild("##Benchmarks");
+        DrawBenchmarks();
+        ImGui::EndChild();
     }
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <array>
 #include <utility>
@@ -15,6 +16,7 @@
 #include "Gui.h"
 #include "Editor.h"
 #include "Debug.h"
+#include "FrameStatistics.h"
 #include "SdfLayerEditor.h"
 #include "SdfLayerSceneGraphEditor.h"
 #include "FileBrowser.h"
@@ -389,17 +391,29 @@ void Editor::WindowSizeCallback(GLFWwindow *window, int width, int height) {
     }
 }
 
-Editor::Editor() : _viewport1(UsdStageRefPtr(), _selection),
+Editor::Editor() : _viewport1(UsdStageRefPtr(), _selection, _boundingBoxCache),
 #if ENABLE_MULTIPLE_VIEWPORTS
-_viewport2(UsdStageRefPtr(), _selection),
-_viewport3(UsdStageRefPtr(), _selection),
-_viewport4(UsdStageRefPtr(), _selection),
+_viewport2(UsdStageRefPtr(), _selection, _boundingBoxCache),
+_viewport3(UsdStageRefPtr(), _selection, _boundingBoxCache),
+_viewport4(UsdStageRefPtr(), _selection, _boundingBoxCache),
 #endif
-_layerHistoryPointer(0) {
+_layerHistoryPointer(0), _primQuery(_primSearchIndex) {
     ExecuteAfterDraw<EditorSetDataPointer>(this); // This is specialized to execute here, not after the draw
     LoadSettings();
+    ApplyUndoMemoryBudget();
     SetFileBrowserDirectory(_settings._lastFileBrowserDirectory);
     Blueprints::GetInstance().SetBlueprintsLocations(_settings._blueprintLocations);
+    // The prim search index, the search query and the text export run in separate threads which must be stopped
+    // before any edition
+    AddBeforeEditionCallback([this]() {
+        _primSearchIndex.Stop();
+        _primQuery.Stop();
+        _layerTextExporter.Stop();
+    });
+}
+
+void Editor::ApplyUndoMemoryBudget() {
+    SetUndoStackMemoryBudget(static_cast<size_t>(_settings._undoMemoryBudgetMB) * 1024 * 1024, _settings._spillUndoToDisk);
 }
 
 Editor::~Editor(){
@@ -437,6 +451,7 @@ void Editor::SetCurrentStage(UsdStageRefPtr stage) {
         _viewport3.SetCurrentStage(stage);
         _viewport4.SetCurrentStage(stage);
 #endif
+        _primSearchIndex.SetStage(stage);
     }
 }
 
@@ -646,6 +661,26 @@ void Editor::HydraRender() {
 
 }
 
+static FrameStatistics frameStatistics;
+
+FrameStatistics &GetFrameStatistics() { return frameStatistics; }
+
+bool Editor::IsIdle() const {
+    // The text cursor blinks and the playback moves the time code
+    if (_isPlaying || _framesToDraw > 0 || ImGui::GetIO().WantTextInput || (_settings._textEditor && _layerTextExporter.IsExporting()))
+        return false;
+#if !( __APPLE__ && PXR_VERSION < 2208)
+    if (_settings._showViewport1 && _viewport1.NeedsRender())
+        return false;
+#if ENABLE_MULTIPLE_VIEWPORTS
+    if ((_settings._showViewport2 && _viewport2.NeedsRender()) || (_settings._showViewport3 && _viewport3.NeedsRender()) ||
+        (_settings._showViewport4 && _viewport4.NeedsRender()))
+        return false;
+#endif
+#endif
+    return true;
+}
+
 void Editor::ShowDialogSaveLayerAs(SdfLayerHandle layerToSaveAs) { DrawModalDialog<SaveLayerAsDialog>(*this, layerToSaveAs); }
 
 
@@ -774,6 +809,16 @@ void Editor::DrawMainMenuBar() {
                 _layerHistory.clear();
                 _layerHistoryPointer = 0;
             }
+            if (ImGui::BeginMenu("Undo memory")) {
+                bool budgetChanged = ImGui::InputInt("Budget (MB)", &_settings._undoMemoryBudgetMB, 256, 1024);
+                budgetChanged |= ImGui::MenuItem("Spill oldest edits to disk", nullptr, &_settings._spillUndoToDisk);
+                if (budgetChanged) {
+                    _settings._undoMemoryBudgetMB = std::max(_settings._undoMemoryBudgetMB, 0);
+                    ApplyUndoMemoryBudget();
+                }
+                ImGui::Text("Used: %.1f MB", GetUndoStackMemoryFootprint() / (1024.0 * 1024.0));
+                ImGui::EndMenu();
+            }
             ImGui::Separator();
             if (ImGui::MenuItem("Cut", "CTRL+X", false, false)) {
             }
@@ -832,6 +877,17 @@ void Editor::DrawMainMenuBar() {
 
 void Editor::Draw() {
 
+    frameStatistics.drawnFrames++;
+    if (!GImGui->InputEventsTrail.empty()) {
+        _framesToDraw = FramesDrawnAfterInput;
+    } else if (_framesToDraw > 0) {
+        _framesToDraw--;
+    }
+
+    // Restart the background indexing and search if the stage has changed
+    _primSearchIndex.Update();
+    _primQuery.Update();
+
     // Main Menu bar
     DrawMainMenuBar();
 
@@ -931,7 +987,7 @@ void Editor::Draw() {
         const ImGuiWindowFlags windowFlagsWithMenu = ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar;
         TRACE_SCOPE(UsdStageHierarchyWindowTitle);
         ImGui::Begin(UsdStageHierarchyWindowTitle, &_settings._showOutliner, windowFlagsWithMenu);
-        DrawStageOutliner(GetCurrentStage(), _selection);
+        DrawStageOutliner(GetCurrentStage(), _selection, _primQuery);
         ImGui::End();
     }
 
@@ -1021,8 +1077,11 @@ void Editor::Draw() {
     if (_settings._textEditor) {
         TRACE_SCOPE(SdfLayerAsciiEditorWindowTitle);
         ImGui::Begin(SdfLayerAsciiEditorWindowTitle, &_settings._textEditor);
-            DrawTextEditor(GetCurrentLayer());
+            DrawTextEditor(GetCurrentLayer(), _selection.GetAnchorPrimPath(GetCurrentLayer()), _layerTextExporter);
         ImGui::End();
+    } else {
+        // Release the layer and its text when the editor is closed
+        _layerTextExporter.SetLayer(nullptr);
     }
 
     if (_settings._showSdfAttributeEditor) {
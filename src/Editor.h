@@ -1,5 +1,9 @@
 #pragma once
+#include "BoundingBoxCache.h"
 #include "EditorSettings.h"
+#include "LayerTextExporter.h"
+#include "PrimQuery.h"
+#include "PrimSearchIndex.h"
 #include "Selection.h"
 #include "Viewport.h"
 #include <pxr/usd/sdf/layer.h>
@@ -29,6 +33,9 @@ public:
     /// Calling Shutdown will stop the main loop
     void Shutdown() { _isShutdown = true; }
     bool IsShutdown() const { return _isShutdown; }
+
+    /// Returns true when nothing has changed since the last frames, the main loop can wait for the next event
+    bool IsIdle() const;
     void RequestShutdown();
     void ConfirmShutdown(std::string why);
 
@@ -57,6 +64,12 @@ public:
     void AddLayerPathSelection(const SdfPath &primPath);
     void SetStagePathSelection(const SdfPath &primPath);
     void AddStagePathSelection(const SdfPath &primPath);
+
+    /// Index of the prim names of the current stage
+    PrimSearchIndex &GetPrimSearchIndex() { return _primSearchIndex; }
+
+    /// Search query of the stage outliner
+    PrimQuery &GetPrimQuery() { return _primQuery; }
     
     /// Create a new layer in file path
     void CreateNewLayer(const std::string &path);
@@ -119,6 +132,7 @@ public:
     /// Interface with the settings
     void LoadSettings();
     void SaveSettings() const;
+    void ApplyUndoMemoryBudget();
 
     /// glfw callback to handle drag and drop from external applications
     static void DropCallback(GLFWwindow *window, int count, const char **paths);
@@ -145,6 +159,11 @@ public:
     EditorSettings _settings;
 
     UsdStageRefPtr _currentStage;
+
+    /// World bounds of the prims of the current stage, shared by the viewports. It is declared before the
+    /// viewports, which keep a reference to it
+    BoundingBoxCache _boundingBoxCache;
+
     Viewport _viewport1;
 #if ENABLE_MULTIPLE_VIEWPORTS
     Viewport _viewport2;
@@ -155,6 +174,15 @@ public:
     /// Selection for stages and layers
     Selection _selection;
 
+    /// Prim names of the current stage, indexed in the background
+    PrimSearchIndex _primSearchIndex;
+
+    /// Current search of the outliner, evaluated in the background
+    PrimQuery _primQuery;
+
+    /// Text of the layer shown in the text editor, exported in the background
+    LayerTextExporter _layerTextExporter;
+
     /// Selected attribute, for showing in the spreadsheet or metadata
     SdfPath _selectedAttribute;
     
@@ -164,5 +192,8 @@ public:
     /// Playback controls
     bool _isPlaying = false;
     std::chrono::time_point<std::chrono::steady_clock> _lastFrameTime;
+
+    /// Frames to draw before the main loop can wait for events
+    int _framesToDraw = FramesDrawnAfterInput;
     
 };
@@ -87,6 +87,10 @@ void EditorSettings::ParseLine(const char *line) {
         if (value > 0) {
             _mainWindowHeight = value;
         }
+    } else if (sscanf(line, "UndoMemoryBudgetMB=%i", &value) == 1) {
+        _undoMemoryBudgetMB = std::max(value, 0);
+    } else if (sscanf(line, "SpillUndoToDisk=%i", &value) == 1) {
+        _spillUndoToDisk = static_cast<bool>(value);
     } else if (strlen(line) > 9 && std::equal(line, line + 9, "Launcher=")) {
         std::string launcher(line + 9);
         auto semiColonPos = std::find(launcher.begin(), launcher.end(), ';');
@@ -135,6 +139,8 @@ void EditorSettings::Dump(ImGuiTextBuffer *buf) {
     if (_mainWindowHeight > 0) {
         buf->appendf("MainWindowHeight=%d\n", _mainWindowHeight);
     }
+    buf->appendf("UndoMemoryBudgetMB=%d\n", _undoMemoryBudgetMB);
+    buf->appendf("SpillUndoToDisk=%d\n", _spillUndoToDisk);
     for (int i = 0; i < _launcherNames.size(); ++i) {
         buf->appendf("Launcher=%s;%s\n", _launcherNames[i].c_str(), _launcherCommandLines[i].c_str());
     }
@@ -33,6 +33,10 @@ struct EditorSettings {
     int _mainWindowWidth;
     int _mainWindowHeight;
 
+    /// Memory budget of the undo history in megabytes, 0 for no limit, and spilling of the oldest edits to disk
+    int _undoMemoryBudgetMB = 2048;
+    bool _spillUndoToDisk = true;
+
     /// Last file browser directory
     std::string _lastFileBrowserDirectory;
 
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+///
+/// Number of frames drawn and skipped by the main loop and the viewports, for debugging. The main loop waits for the
+/// next event when nothing has changed, and the viewports render only when one of their inputs has changed.
+///
+struct FrameStatistics {
+    size_t drawnFrames = 0;           // Frames of the user interface
+    size_t idleWaits = 0;             // Iterations of the main loop waiting for an event
+    size_t renderedViewportFrames = 0;
+    size_t skippedViewportFrames = 0; // The previous image of the viewport was kept
+};
+
+FrameStatistics &GetFrameStatistics();
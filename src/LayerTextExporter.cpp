@@ -0,0 +1,101 @@
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/sdf/copyUtils.h>
+
+#include "Commands.h"
+#include "LayerTextExporter.h"
+
+// Time without layer change before a new export starts
+static constexpr std::chrono::milliseconds ExportDelay(300);
+
+LayerTextExporter::~LayerTextExporter() {
+    Stop();
+    TfNotice::Revoke(_layersChangedKey);
+}
+
+void LayerTextExporter::SetLayer(SdfLayerRefPtr layer) {
+    if (layer == _layer)
+        return;
+    Stop();
+    TfNotice::Revoke(_layersChangedKey);
+    _layer = layer;
+    _primPath = SdfPath();
+    _text.clear();
+    _lineOffsets.clear();
+    _exportedText.clear();
+    _exportedLineOffsets.clear();
+    _generation++;
+    // The new layer is exported at the next update
+    _changeCount++;
+    if (_layer) {
+        _layersChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerTextExporter::OnLayersChanged,
+                                               SdfLayerHandle(_layer));
+    }
+}
+
+void LayerTextExporter::SetPrimPath(const SdfPath &primPath) {
+    if (primPath == _primPath)
+        return;
+    Stop();
+    _primPath = primPath;
+    _changeCount++;
+}
+
+// The prim is copied in a scratch layer which is exported
+static void ExportPrimToString(const SdfLayerRefPtr &layer, const SdfPath &primPath, std::string *text) {
+    if (!primPath.IsPrimPath() || !layer->GetPrimAtPath(primPath))
+        return;
+    SdfLayerRefPtr scratchLayer = SdfLayer::CreateAnonymous("prim.usda");
+    if (SdfCopySpec(layer, primPath, scratchLayer, SdfPath::AbsoluteRootPath().AppendChild(primPath.GetNameToken()))) {
+        scratchLayer->ExportToString(text);
+    }
+}
+
+void LayerTextExporter::OnLayersChanged(const SdfNotice::LayersDidChangeSentPerLayer &notice, const SdfLayerHandle &sender) {
+    _changeCount++;
+    _lastChangeTime = std::chrono::steady_clock::now();
+}
+
+void LayerTextExporter::Update() {
+    if (_isRunning)
+        return;
+    Stop();
+    // The worker is not restarted while the layer is being edited by a manipulator or was edited recently
+    if (_layer && _changeCount != _exportedChangeCount && !IsEditionInProgress() &&
+        std::chrono::steady_clock::now() - _lastChangeTime >= ExportDelay) {
+        _exportingChangeCount = _changeCount;
+        _isRunning = true;
+        _worker = std::thread([this]() {
+            TRACE_FUNCTION();
+            if (_primPath.IsEmpty()) {
+                _layer->ExportToString(&_exportedText);
+            } else {
+                ExportPrimToString(_layer, _primPath, &_exportedText);
+            }
+            _exportedLineOffsets.push_back(0);
+            for (size_t position = _exportedText.find('\n'); position != std::string::npos;
+                 position = _exportedText.find('\n', position + 1)) {
+                _exportedLineOffsets.push_back(position + 1);
+            }
+            _isRunning = false;
+        });
+    }
+}
+
+// ExportToString can't be interrupted, the edition waits for the end of the export
+void LayerTextExporter::Stop() {
+    if (_worker.joinable()) {
+        _worker.join();
+        CollectText();
+    }
+}
+
+void LayerTextExporter::CollectText() {
+    _text.swap(_exportedText);
+    _lineOffsets.swap(_exportedLineOffsets);
+    _exportedText.clear();
+    _exportedLineOffsets.clear();
+    _exportedChangeCount = _exportingChangeCount;
+    _generation++;
+}
+
+bool LayerTextExporter::IsExporting() const { return _isRunning || (_layer && _changeCount != _exportedChangeCount); }
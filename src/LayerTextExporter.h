@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/notice.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Text of a layer for the text editor. The layer is exported on a worker thread, only when it has changed since
+/// the last export, and the text is split in lines so the ui can draw only the visible ones.
+/// The export can be limited to a prim, the cost is then proportional to the prim and not to the layer.
+///
+class LayerTextExporter : public TfWeakBase {
+  public:
+    LayerTextExporter() = default;
+    ~LayerTextExporter();
+
+    // Delete copy
+    LayerTextExporter(const LayerTextExporter &) = delete;
+    LayerTextExporter &operator=(const LayerTextExporter &) = delete;
+
+    /// Export a new layer, the text of the previous layer is discarded
+    void SetLayer(SdfLayerRefPtr layer);
+    const SdfLayerRefPtr &GetLayer() const { return _layer; }
+
+    /// Export only the prim spec at primPath and its descendants, as the root prim of a layer.
+    /// The whole layer is exported when primPath is empty.
+    void SetPrimPath(const SdfPath &primPath);
+    const SdfPath &GetPrimPath() const { return _primPath; }
+
+    /// Collect the text exported by the worker thread and start a new export if the layer has changed.
+    /// It is called once per frame while the text is displayed. The export starts once the layer hasn't changed
+    /// for a short delay, so a continuous edition like a slider drag doesn't wait for an export at each frame.
+    void Update();
+
+    /// Wait for the worker thread, the layer must not be edited while it is exporting
+    void Stop();
+
+    /// Returns true until the text is up to date with the layer, false when there is no layer to export
+    bool IsExporting() const;
+
+    /// The generation changes every time the text is replaced
+    size_t GetGeneration() const { return _generation; }
+
+    const std::string &GetText() const { return _text; }
+
+    /// Offsets of the beginning of the lines in the text
+    const std::vector<size_t> &GetLineOffsets() const { return _lineOffsets; }
+
+  private:
+    void OnLayersChanged(const SdfNotice::LayersDidChangeSentPerLayer &notice, const SdfLayerHandle &sender);
+    void CollectText();
+
+    SdfLayerRefPtr _layer;
+    SdfPath _primPath;
+    TfNotice::Key _layersChangedKey;
+
+    // The layer changes counted by the notices, and the change exported in the text or being exported
+    size_t _changeCount = 0;
+    size_t _exportedChangeCount = 0;
+    size_t _exportingChangeCount = 0;
+    std::chrono::steady_clock::time_point _lastChangeTime;
+
+    std::string _text;
+    std::vector<size_t> _lineOffsets;
+    size_t _generation = 0;
+
+    // Worker thread results, read after the thread has finished
+    std::string _exportedText;
+    std::vector<size_t> _exportedLineOffsets;
+
+    std::thread _worker;
+    std::atomic<bool> _isRunning = {false};
+};
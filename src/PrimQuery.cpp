@@ -0,0 +1,350 @@
+#include <cctype>
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/usd/modelAPI.h>
+#include <pxr/usd/usd/primRange.h>
+
+#include "Commands.h"
+#include "PrimQuery.h"
+#include "PrimSearchIndex.h"
+#include "WildcardsCompare.h"
+
+/// Node of a parsed query expression
+struct PrimQueryNode {
+    enum Type { And, Or, Not, Name, TypeName, Kind, AppliedSchema, Attribute, Metadata, Path };
+    Type type;
+    std::string pattern;
+    bool hasWildcards = false;
+    TfToken key; // attribute name or metadata key
+    std::unique_ptr<PrimQueryNode> left;
+    std::unique_ptr<PrimQueryNode> right;
+};
+
+namespace {
+
+// Split the expression in words, parenthesis and operators
+std::vector<std::string> Tokenize(const std::string &expression) {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < expression.size()) {
+        const char c = expression[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (c == '(' || c == ')' || c == '!') {
+            tokens.emplace_back(1, c);
+            i++;
+        } else if ((c == '&' || c == '|') && i + 1 < expression.size() && expression[i + 1] == c) {
+            tokens.emplace_back(2, c);
+            i += 2;
+        } else {
+            const size_t end = expression.find_first_of(" \t()", i);
+            tokens.push_back(expression.substr(i, end == std::string::npos ? std::string::npos : end - i));
+            i = end == std::string::npos ? expression.size() : end;
+        }
+    }
+    return tokens;
+}
+
+// Recursive descent parser of the token list
+class PrimQueryParser {
+  public:
+    PrimQueryParser(const std::vector<std::string> &tokens) : _tokens(tokens) {}
+
+    std::unique_ptr<PrimQueryNode> Parse(std::string &error) {
+        auto root = ParseOr();
+        if (_error.empty() && _current < _tokens.size()) {
+            _error = "unexpected '" + _tokens[_current] + "'";
+        }
+        error = _error;
+        return _error.empty() ? std::move(root) : nullptr;
+    }
+
+  private:
+    bool Accept(const char *token, const char *alias) {
+        if (_current < _tokens.size() && (_tokens[_current] == token || _tokens[_current] == alias)) {
+            _current++;
+            return true;
+        }
+        return false;
+    }
+
+    static std::unique_ptr<PrimQueryNode> MakeOperator(PrimQueryNode::Type type, std::unique_ptr<PrimQueryNode> left,
+                                                       std::unique_ptr<PrimQueryNode> right) {
+        auto node = std::make_unique<PrimQueryNode>();
+        node->type = type;
+        node->left = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    std::unique_ptr<PrimQueryNode> ParseOr() {
+        auto node = ParseAnd();
+        while (node && Accept("or", "||")) {
+            auto right = ParseAnd();
+            if (!right)
+                return nullptr;
+            node = MakeOperator(PrimQueryNode::Or, std::move(node), std::move(right));
+        }
+        return node;
+    }
+
+    // "and" is optional between two terms
+    std::unique_ptr<PrimQueryNode> ParseAnd() {
+        auto node = ParseNot();
+        while (node && _current < _tokens.size()) {
+            if (!Accept("and", "&&") && (_tokens[_current] == ")" || _tokens[_current] == "or" || _tokens[_current] == "||"))
+                break;
+            auto right = ParseNot();
+            if (!right)
+                return nullptr;
+            node = MakeOperator(PrimQueryNode::And, std::move(node), std::move(right));
+        }
+        return node;
+    }
+
+    std::unique_ptr<PrimQueryNode> ParseNot() {
+        if (Accept("not", "!")) {
+            auto operand = ParseNot();
+            return operand ? MakeOperator(PrimQueryNode::Not, std::move(operand), nullptr) : nullptr;
+        }
+        return ParsePrimary();
+    }
+
+    std::unique_ptr<PrimQueryNode> ParsePrimary() {
+        if (_current >= _tokens.size()) {
+            _error = "unexpected end of expression";
+            return nullptr;
+        }
+        if (Accept("(", "(")) {
+            auto node = ParseOr();
+            if (node && !Accept(")", ")")) {
+                _error = "missing ')'";
+                return nullptr;
+            }
+            return node;
+        }
+        const std::string &token = _tokens[_current];
+        if (token == ")" || token == "and" || token == "&&" || token == "or" || token == "||") {
+            _error = "unexpected '" + token + "'";
+            return nullptr;
+        }
+        _current++;
+        return ParseTerm(token);
+    }
+
+    std::unique_ptr<PrimQueryNode> ParseTerm(const std::string &token) {
+        auto node = std::make_unique<PrimQueryNode>();
+        const size_t separator = token.find(':');
+        const std::string predicate = separator == std::string::npos ? "name" : token.substr(0, separator);
+        node->pattern = separator == std::string::npos ? token : token.substr(separator + 1);
+        if (predicate == "name") {
+            node->type = PrimQueryNode::Name;
+        } else if (predicate == "type") {
+            node->type = PrimQueryNode::TypeName;
+        } else if (predicate == "kind") {
+            node->type = PrimQueryNode::Kind;
+        } else if (predicate == "api") {
+            node->type = PrimQueryNode::AppliedSchema;
+        } else if (predicate == "attr") {
+            node->type = PrimQueryNode::Attribute;
+        } else if (predicate == "meta") {
+            node->type = PrimQueryNode::Metadata;
+            const size_t equal = node->pattern.find('=');
+            node->key = TfToken(node->pattern.substr(0, equal));
+            node->pattern = equal == std::string::npos ? std::string() : node->pattern.substr(equal + 1);
+            if (node->key.IsEmpty()) {
+                _error = "missing metadata key in '" + token + "'";
+                return nullptr;
+            }
+        } else if (predicate == "path") {
+            node->type = PrimQueryNode::Path;
+        } else {
+            _error = "unknown predicate '" + predicate + "'";
+            return nullptr;
+        }
+        if (node->pattern.empty() && node->type != PrimQueryNode::Metadata) {
+            _error = "missing value in '" + token + "'";
+            return nullptr;
+        }
+        node->hasWildcards = node->pattern.find_first_of("*?") != std::string::npos;
+        if (node->type == PrimQueryNode::Attribute && !node->hasWildcards) {
+            node->key = TfToken(node->pattern);
+        }
+        return node;
+    }
+
+    const std::vector<std::string> &_tokens;
+    size_t _current = 0;
+    std::string _error;
+};
+
+inline bool Matches(const PrimQueryNode &node, const std::string &str) {
+    return node.hasWildcards ? FastWildComparePortable(node.pattern.c_str(), str.c_str()) : str == node.pattern;
+}
+
+// String used to compare the metadata values with the pattern
+std::string MetadataToString(const VtValue &value) {
+    if (value.IsHolding<bool>()) {
+        return value.UncheckedGet<bool>() ? "true" : "false";
+    } else if (value.IsHolding<TfToken>()) {
+        return value.UncheckedGet<TfToken>().GetString();
+    } else if (value.IsHolding<std::string>()) {
+        return value.UncheckedGet<std::string>();
+    }
+    return TfStringify(value);
+}
+
+bool Evaluate(const PrimQueryNode &node, const UsdPrim &prim) {
+    switch (node.type) {
+    case PrimQueryNode::And:
+        return Evaluate(*node.left, prim) && Evaluate(*node.right, prim);
+    case PrimQueryNode::Or:
+        return Evaluate(*node.left, prim) || Evaluate(*node.right, prim);
+    case PrimQueryNode::Not:
+        return !Evaluate(*node.left, prim);
+    case PrimQueryNode::Name:
+        return Matches(node, prim.GetName().GetString());
+    case PrimQueryNode::TypeName:
+        return Matches(node, prim.GetTypeName().GetString());
+    case PrimQueryNode::Kind: {
+        TfToken kind;
+        return UsdModelAPI(prim).GetKind(&kind) && Matches(node, kind.GetString());
+    }
+    case PrimQueryNode::AppliedSchema:
+        for (const TfToken &schema : prim.GetAppliedSchemas()) {
+            if (Matches(node, schema.GetString()))
+                return true;
+        }
+        return false;
+    case PrimQueryNode::Attribute:
+        if (!node.hasWildcards) {
+            const UsdAttribute attribute = prim.GetAttribute(node.key);
+            return attribute && attribute.IsAuthored();
+        }
+        for (const UsdAttribute &attribute : prim.GetAuthoredAttributes()) {
+            if (Matches(node, attribute.GetName().GetString()))
+                return true;
+        }
+        return false;
+    case PrimQueryNode::Metadata: {
+        if (node.pattern.empty()) {
+            return prim.HasAuthoredMetadata(node.key);
+        }
+        VtValue value;
+        return prim.GetMetadata(node.key, &value) && Matches(node, MetadataToString(value));
+    }
+    case PrimQueryNode::Path:
+        return Matches(node, prim.GetPath().GetString());
+    }
+    return false;
+}
+
+} // namespace
+
+PrimQuery::PrimQuery(const PrimSearchIndex &searchIndex) : _searchIndex(searchIndex) {}
+
+PrimQuery::~PrimQuery() {
+    Cancel();
+    TfNotice::Revoke(_objectsChangedKey);
+}
+
+bool PrimQuery::Run(UsdStageRefPtr stage, const std::string &expression) {
+    Cancel();
+    if (stage != _stage) {
+        TfNotice::Revoke(_objectsChangedKey);
+        if (stage) {
+            _objectsChangedKey =
+                TfNotice::Register(TfCreateWeakPtr(this), &PrimQuery::OnObjectsChanged, UsdStageWeakPtr(stage));
+        }
+    }
+    _stage = stage;
+    _expression = expression;
+    _error.clear();
+    _root = TfStringTrim(expression).empty() ? nullptr : PrimQueryParser(Tokenize(expression)).Parse(_error);
+    Start();
+    return _error.empty();
+}
+
+void PrimQuery::Cancel() {
+    if (_runner.joinable()) {
+        // The subtrees not visited yet are missing from the results
+        _mustRestart = _mustRestart || _isRunning;
+        _cancelRequested = true;
+        _runner.join();
+        _cancelRequested = false;
+    }
+}
+
+// The edition can rename, remove or create prims and author the attributes and metadata, the results of a finished
+// search are outdated as well
+void PrimQuery::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    _mustRestart = _mustRestart || _root != nullptr;
+}
+
+void PrimQuery::Update() {
+    // The search is not restarted while the stage is being edited by a manipulator
+    if (IsEditionInProgress())
+        return;
+    if (_mustRestart || (_usesSearchIndex && _searchIndex.GetGeneration() != _searchIndexGeneration)) {
+        Start();
+    }
+}
+
+void PrimQuery::FetchResults(SdfPathVector &results) const {
+    std::lock_guard<std::mutex> lock(_resultsMutex);
+    if (results.size() < _results.size()) {
+        results.insert(results.end(), _results.begin() + results.size(), _results.end());
+    }
+}
+
+void PrimQuery::Start() {
+    {
+        std::lock_guard<std::mutex> lock(_resultsMutex);
+        _results.clear();
+    }
+    _generation++;
+    _mustRestart = false;
+    _usesSearchIndex = false;
+    if (!_stage || !_root)
+        return;
+
+    // The name index answers the simple name searches once it is complete
+    if (_root->type == PrimQueryNode::Name && !_searchIndex.IsIndexing()) {
+        std::lock_guard<std::mutex> lock(_resultsMutex);
+        _usesSearchIndex = true;
+        _searchIndexGeneration = _searchIndex.GetGeneration();
+        _searchIndex.FindPrims(_root->pattern, _root->hasWildcards, _results);
+        return;
+    }
+
+    _isRunning = true;
+    _runner = std::thread([this]() {
+        TRACE_FUNCTION();
+        WorkDispatcher dispatcher;
+        const UsdPrim pseudoRoot = _stage->GetPseudoRoot();
+        dispatcher.Run([this, pseudoRoot, &dispatcher]() { VisitChildren(pseudoRoot, dispatcher); });
+        dispatcher.Wait();
+        _isRunning = false;
+    });
+}
+
+// Evaluate the children of a prim and spawn a task for each child subtree. The work stealing scheduler
+// of the dispatcher balances the subtrees between the threads. The task of a leaf prim returns after an empty loop,
+// which is cheaper than traversing its children twice.
+void PrimQuery::VisitChildren(const UsdPrim &prim, WorkDispatcher &dispatcher) {
+    if (_cancelRequested)
+        return;
+    const auto predicate = UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate);
+    SdfPathVector matches;
+    for (const UsdPrim &child : prim.GetFilteredChildren(predicate)) {
+        if (Evaluate(*_root, child)) {
+            matches.push_back(child.GetPath());
+        }
+        dispatcher.Run([this, child, &dispatcher]() { VisitChildren(child, dispatcher); });
+    }
+    if (!matches.empty()) {
+        std::lock_guard<std::mutex> lock(_resultsMutex);
+        _results.insert(_results.end(), matches.begin(), matches.end());
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/base/work/dispatcher.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+class PrimSearchIndex;
+struct PrimQueryNode;
+
+///
+/// Search engine of the outliner. It evaluates a predicate expression on all the prims of a stage, in parallel,
+/// and streams the matching paths to the ui.
+///
+/// The expression is a list of terms combined with "and", "or", "not" and parenthesis, two consecutive terms
+/// are combined with "and". The terms are:
+///     name              prims named "name", the same as name:name
+///     name:pattern      prim name
+///     type:pattern      prim type name
+///     kind:pattern      model kind
+///     api:pattern       applied API schema
+///     attr:pattern      authored attribute name
+///     meta:key          authored metadata
+///     meta:key=pattern  metadata value
+///     path:pattern      prim path
+/// The patterns accept the wildcards * and ?
+///
+/// The search is restarted when the stage is changed, as the results can be outdated.
+///
+class PrimQuery : public TfWeakBase {
+  public:
+    PrimQuery(const PrimSearchIndex &searchIndex);
+    ~PrimQuery();
+
+    // Delete copy
+    PrimQuery(const PrimQuery &) = delete;
+    PrimQuery &operator=(const PrimQuery &) = delete;
+
+    /// Parse the expression and start searching the stage. The previous search is cancelled.
+    /// Returns false if the expression is invalid, GetError() then returns the reason.
+    bool Run(UsdStageRefPtr stage, const std::string &expression);
+
+    /// Cancel the current search, the results found so far are kept.
+    /// An unfinished search is restarted at the next Update.
+    void Cancel();
+
+    /// Stop the current search before the stage is edited
+    void Stop() { Cancel(); }
+
+    /// Restart the search cancelled before the end or outdated by a change of the stage. It is called once per frame.
+    void Update();
+
+    bool IsRunning() const { return _isRunning; }
+    const std::string &GetExpression() const { return _expression; }
+    const std::string &GetError() const { return _error; }
+    const UsdStageRefPtr &GetStage() const { return _stage; }
+
+    /// The generation changes every time the results are reset
+    size_t GetGeneration() const { return _generation; }
+
+    /// Append to results the paths found after the first results.size() ones. The results are in no particular order.
+    void FetchResults(SdfPathVector &results) const;
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+    void Start();
+    void VisitChildren(const UsdPrim &prim, WorkDispatcher &dispatcher);
+
+    const PrimSearchIndex &_searchIndex;
+    UsdStageRefPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    std::string _expression;
+    std::string _error;
+    std::unique_ptr<PrimQueryNode> _root;
+
+    mutable std::mutex _resultsMutex;
+    SdfPathVector _results;
+
+    std::thread _runner;
+    std::atomic<bool> _isRunning = {false};
+    std::atomic<bool> _cancelRequested = {false};
+    bool _mustRestart = false;
+    size_t _generation = 0;
+
+    // Generation of the search index when it answered the query
+    bool _usesSearchIndex = false;
+    size_t _searchIndexGeneration = 0;
+};
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/usd/primRange.h>
+
+#include "Commands.h"
+#include "PrimSearchIndex.h"
+#include "WildcardsCompare.h"
+
+// Number of prims expanded by the worker thread before publishing their children in the index
+constexpr size_t IndexingBatchSize = 256;
+
+// Pack the 3 characters starting at position in a single integer
+static inline uint32_t GetTrigram(const std::string &str, size_t position) {
+    return static_cast<unsigned char>(str[position]) << 16 | static_cast<unsigned char>(str[position + 1]) << 8 |
+           static_cast<unsigned char>(str[position + 2]);
+}
+
+// Returns the unique trigrams of the literal parts of a wildcard pattern
+static std::vector<uint32_t> GetPatternTrigrams(const std::string &pattern) {
+    std::vector<uint32_t> trigrams;
+    size_t start = 0;
+    while (start < pattern.size()) {
+        size_t end = pattern.find_first_of("*?", start);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        for (size_t i = start; i + 2 < end; ++i) {
+            trigrams.push_back(GetTrigram(pattern, i));
+        }
+        start = end + 1;
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+PrimSearchIndex::~PrimSearchIndex() {
+    Stop();
+    TfNotice::Revoke(_objectsChangedKey);
+}
+
+void PrimSearchIndex::SetStage(UsdStageRefPtr stage) {
+    if (stage == _stage)
+        return;
+    Stop();
+    TfNotice::Revoke(_objectsChangedKey);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _names.clear();
+    _nameIds.clear();
+    _paths.clear();
+    _pathNames.clear();
+    _trigrams.clear();
+    _primsToIndex.clear();
+    _resyncedPaths.clear();
+    _indexedPrimCount = 0;
+    _stage = stage;
+    if (_stage) {
+        _objectsChangedKey =
+            TfNotice::Register(TfCreateWeakPtr(this), &PrimSearchIndex::OnObjectsChanged, UsdStageWeakPtr(_stage));
+        _primsToIndex.push_back(_stage->GetPseudoRoot());
+    }
+    _generation++;
+}
+
+void PrimSearchIndex::Update() {
+    // The worker is not restarted while the stage is being edited by a manipulator
+    if (_isRunning || IsEditionInProgress())
+        return;
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+    if (IsIndexing()) {
+        _isRunning = true;
+        _worker = std::thread([this]() {
+            IndexPrims();
+            _isRunning = false;
+        });
+    }
+}
+
+void PrimSearchIndex::Stop() {
+    if (_worker.joinable()) {
+        _stopRequested = true;
+        _worker.join();
+        _stopRequested = false;
+    }
+}
+
+bool PrimSearchIndex::IsIndexing() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_primsToIndex.empty() || !_resyncedPaths.empty();
+}
+
+void PrimSearchIndex::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    // The resynced prims are reindexed by the worker thread, the info changes are ignored as they don't modify the names
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        if (path.IsAbsoluteRootOrPrimPath()) {
+            _resyncedPaths.insert(path);
+        }
+    }
+}
+
+// Expand the prims waiting to be indexed by batches. The stage is only read outside of the lock, so the ui can
+// search the index while it is populated.
+void PrimSearchIndex::IndexPrims() {
+    TRACE_FUNCTION();
+    const auto predicate = UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate);
+    std::vector<UsdPrim> batch;
+    std::vector<UsdPrim> children;
+    batch.reserve(IndexingBatchSize);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            RemoveResyncedPrims();
+            // Publish the children found in the previous batch
+            for (const UsdPrim &child : children) {
+                InsertPrim(child.GetName(), child.GetPath());
+            }
+            if (!children.empty()) {
+                _primsToIndex.insert(_primsToIndex.end(), children.begin(), children.end());
+                _generation++;
+            }
+            children.clear();
+            if (_stopRequested || _primsToIndex.empty()) {
+                break;
+            }
+            const size_t batchSize = std::min(IndexingBatchSize, _primsToIndex.size());
+            batch.assign(_primsToIndex.end() - batchSize, _primsToIndex.end());
+            _primsToIndex.resize(_primsToIndex.size() - batchSize);
+        }
+        for (const UsdPrim &prim : batch) {
+            if (prim.IsValid()) {
+                for (const UsdPrim &child : prim.GetFilteredChildren(predicate)) {
+                    children.push_back(child);
+                }
+            }
+        }
+    }
+}
+
+// Must be called with the mutex locked
+void PrimSearchIndex::RemoveResyncedPrims() {
+    if (_resyncedPaths.empty())
+        return;
+
+    if (_resyncedPaths.count(SdfPath::AbsoluteRootPath())) {
+        _names.clear();
+        _nameIds.clear();
+        _paths.clear();
+        _pathNames.clear();
+        _trigrams.clear();
+        _indexedPrimCount = 0;
+        _primsToIndex.clear();
+        _primsToIndex.push_back(_stage->GetPseudoRoot());
+        _resyncedPaths.clear();
+        _generation++;
+        return;
+    }
+
+    // Only the indexed prims under the resynced paths are visited
+    SdfPathVector resyncedPaths(_resyncedPaths.begin(), _resyncedPaths.end());
+    SdfPath::RemoveDescendentPaths(&resyncedPaths);
+    for (const SdfPath &resyncedPath : resyncedPaths) {
+        auto it = _pathNames.lower_bound(resyncedPath);
+        while (it != _pathNames.end() && it->first.HasPrefix(resyncedPath)) {
+            _paths[it->second].erase(it->first);
+            it = _pathNames.erase(it);
+            _indexedPrimCount--;
+        }
+    }
+    const auto isResynced = [this](const SdfPath &path) {
+        return SdfPathFindLongestPrefix(_resyncedPaths, path) != _resyncedPaths.end();
+    };
+    _primsToIndex.erase(std::remove_if(_primsToIndex.begin(), _primsToIndex.end(),
+                                       [&](const UsdPrim &prim) { return !prim.IsValid() || isResynced(prim.GetPath()); }),
+                        _primsToIndex.end());
+
+    // The resynced prims are indexed again unless their parent is still waiting to be expanded
+    std::set<SdfPath> waitingPaths;
+    for (const UsdPrim &prim : _primsToIndex) {
+        waitingPaths.insert(prim.GetPath());
+    }
+    for (const SdfPath &path : resyncedPaths) {
+        if (SdfPathFindLongestPrefix(waitingPaths, path.GetParentPath()) != waitingPaths.end())
+            continue;
+        if (const UsdPrim prim = _stage->GetPrimAtPath(path)) {
+            InsertPrim(prim.GetName(), path);
+            _primsToIndex.push_back(prim);
+        }
+    }
+    _resyncedPaths.clear();
+    _generation++;
+}
+
+// Must be called with the mutex locked
+void PrimSearchIndex::InsertPrim(const TfToken &name, const SdfPath &path) {
+    auto found = _nameIds.find(name);
+    if (found == _nameIds.end()) {
+        const NameId nameId = static_cast<NameId>(_names.size());
+        found = _nameIds.emplace(name, nameId).first;
+        _names.push_back(name);
+        _paths.emplace_back();
+        InsertTrigrams(name.GetString(), nameId);
+    }
+    if (_paths[found->second].insert(path).second) {
+        _pathNames.emplace(path, found->second);
+        _indexedPrimCount++;
+    }
+}
+
+// Must be called with the mutex locked. The name ids are increasing, so the trigram lists stay sorted.
+void PrimSearchIndex::InsertTrigrams(const std::string &name, NameId nameId) {
+    std::vector<Trigram> trigrams;
+    for (size_t i = 0; i + 2 < name.size(); ++i) {
+        trigrams.push_back(GetTrigram(name, i));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    for (const Trigram trigram : trigrams) {
+        _trigrams[trigram].push_back(nameId);
+    }
+}
+
+void PrimSearchIndex::FindPrims(const std::string &pattern, bool useWildcards, SdfPathVector &matches) const {
+    matches.clear();
+    if (pattern.empty())
+        return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!useWildcards) {
+        const auto found = _nameIds.find(TfToken::Find(pattern));
+        if (found != _nameIds.end()) {
+            matches.assign(_paths[found->second].begin(), _paths[found->second].end());
+        }
+    } else {
+        // Candidate names contain all the trigrams of the pattern, they are then compared with the full pattern
+        std::vector<const std::vector<NameId> *> postingLists;
+        for (const Trigram trigram : GetPatternTrigrams(pattern)) {
+            const auto found = _trigrams.find(trigram);
+            if (found == _trigrams.end())
+                return;
+            postingLists.push_back(&found->second);
+        }
+        std::vector<NameId> candidates;
+        if (postingLists.empty()) {
+            candidates.resize(_names.size());
+            std::iota(candidates.begin(), candidates.end(), 0);
+        } else {
+            std::sort(postingLists.begin(), postingLists.end(),
+                      [](const std::vector<NameId> *a, const std::vector<NameId> *b) { return a->size() < b->size(); });
+            candidates = *postingLists[0];
+            for (size_t i = 1; i < postingLists.size() && !candidates.empty(); ++i) {
+                std::vector<NameId> intersection;
+                std::set_intersection(candidates.begin(), candidates.end(), postingLists[i]->begin(), postingLists[i]->end(),
+                                      std::back_inserter(intersection));
+                candidates.swap(intersection);
+            }
+        }
+        for (const NameId nameId : candidates) {
+            if (!_paths[nameId].empty() && FastWildComparePortable(pattern.c_str(), _names[nameId].GetText())) {
+                matches.insert(matches.end(), _paths[nameId].begin(), _paths[nameId].end());
+            }
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+}
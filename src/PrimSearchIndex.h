@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Index of the prim names of a stage, to find prims without traversing the whole stage.
+/// It maps the names to their prim paths and keeps a trigram index of the names to accelerate
+/// the wildcard searches. The index is populated on a worker thread and updated when the stage is resynced.
+///
+class PrimSearchIndex : public TfWeakBase {
+  public:
+    PrimSearchIndex() = default;
+    ~PrimSearchIndex();
+
+    // Delete copy
+    PrimSearchIndex(const PrimSearchIndex &) = delete;
+    PrimSearchIndex &operator=(const PrimSearchIndex &) = delete;
+
+    /// Index a new stage, the index of the previous stage is discarded
+    void SetStage(UsdStageRefPtr stage);
+
+    /// Start the worker thread if there are prims waiting to be indexed. It is called once per frame.
+    void Update();
+
+    /// Stop the worker thread, the prims not indexed yet are kept for the next Update.
+    /// The stage must not be edited while the worker thread is running.
+    void Stop();
+
+    /// Returns true while the index is incomplete
+    bool IsIndexing() const;
+
+    /// The generation changes every time the index is modified, the results of the previous searches are outdated.
+    size_t GetGeneration() const { return _generation; }
+
+    /// Number of prims indexed
+    size_t GetIndexedPrimCount() const { return _indexedPrimCount; }
+
+    /// Returns the sorted paths of the prims whose name matches the pattern.
+    /// While the index is populated, the search returns only the prims indexed so far.
+    void FindPrims(const std::string &pattern, bool useWildcards, SdfPathVector &matches) const;
+
+  private:
+    using NameId = uint32_t;
+    using Trigram = uint32_t;
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    // Worker thread functions
+    void IndexPrims();
+    void RemoveResyncedPrims();
+    void InsertPrim(const TfToken &name, const SdfPath &path);
+    void InsertTrigrams(const std::string &name, NameId nameId);
+
+    UsdStageRefPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+
+    // Index, guarded by the mutex as it is read by the ui while the worker thread populates it
+    mutable std::mutex _mutex;
+    std::vector<TfToken> _names;
+    std::unordered_map<TfToken, NameId, TfToken::HashFunctor> _nameIds;
+    std::vector<std::set<SdfPath>> _paths; // Per name id
+    std::map<SdfPath, NameId> _pathNames;  // Ordered, the prims under a resynced path are a contiguous range
+    std::unordered_map<Trigram, std::vector<NameId>> _trigrams;
+
+    // Prims whose children are waiting to be indexed and prims resynced since the last update
+    std::vector<UsdPrim> _primsToIndex;
+    std::set<SdfPath> _resyncedPaths;
+
+    std::thread _worker;
+    std::atomic<bool> _isRunning = {false};
+    std::atomic<bool> _stopRequested = {false};
+    std::atomic<size_t> _generation = {0};
+    std::atomic<size_t> _indexedPrimCount = {0};
+};
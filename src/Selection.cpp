@@ -1,53 +1,144 @@
 #include "Selection.h"
+#include <algorithm>
 #include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <pxr/usd/sdf/attributeSpec.h>
 #include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usd/stage.h>
 
 #include <iostream>
 
-/// At the moment we use a HdSelection for the stages but this will change as the we want to store additional states
-/// The selection implementation will move outside this header
-#include <pxr/imaging/hd/selection.h>
-
-/// Note the following bit of code might have terrible performances when selecting thousands of paths
-/// This has to be tested at some point
 namespace std {
-template <> struct hash<SdfPathVector> {
-    std::size_t operator()(SdfPathVector const &paths) const noexcept {
-        std::size_t hashValue = 0;
-        for (const auto p : paths) {
-            const auto pathHash = SdfPath::Hash{}(p);
-            hashValue = pathHash ^ (hashValue << 1);
-        }
-        return hashValue;
-    }
-};
-
 template <> struct hash<SdfSpecHandle> {
     std::size_t operator()(SdfSpecHandle const &spec) const noexcept { return hash_value(spec); }
 };
 
 } // namespace std
 
-struct StageSelection : public std::unique_ptr<HdSelection> {
-    // We store a state to know if the selection has changed between frames. Recomputing the hash is not ideal and potentially
-    // a performance killer, so it will likely change in the future
-    SelectionHash selectionHash = 0;
-    bool mustRecomputeHash = true;
+// Selection generations are unique among all the owners
+static SelectionHash NextSelectionGeneration() {
+    static SelectionHash generation = 0;
+    return ++generation;
+}
+
+/// Selected prims of a stage:
+/// - the paths are kept in selection order, the first one being the anchor
+/// - a hash map gives the membership in constant time
+/// - a sorted set keeps the descendants of a path contiguous, a selected subtree is found in O(log n)
+/// - the ancestors of the selected paths count their selected descendants, for the hierarchy queries of the widgets
+/// The generation is incremented at each modification, so the widgets can find out if the selection has changed between
+/// frames by comparing integers.
+struct StageSelection {
+    bool Add(const SdfPath &path) {
+        if (!selectionOrders.emplace(path, nextOrder).second)
+            return false;
+        orderedPaths.emplace(nextOrder++, path);
+        sortedPaths.insert(path);
+        for (SdfPath ancestor = path.GetParentPath(); !ancestor.IsEmpty(); ancestor = ancestor.GetParentPath()) {
+            descendantCounts[ancestor]++;
+        }
+        generation = NextSelectionGeneration();
+        return true;
+    }
+
+    bool Remove(const SdfPath &path) {
+        const auto found = selectionOrders.find(path);
+        if (found == selectionOrders.end())
+            return false;
+        RemoveFromIndices(found);
+        sortedPaths.erase(path);
+        generation = NextSelectionGeneration();
+        return true;
+    }
+
+    // Remove a path and its selected descendants in time proportional to the number of removed paths
+    void RemoveSubtree(const SdfPath &root) {
+        const auto first = sortedPaths.lower_bound(root);
+        auto last = first;
+        while (last != sortedPaths.end() && last->HasPrefix(root)) {
+            RemoveFromIndices(selectionOrders.find(*last));
+            ++last;
+        }
+        if (first != last) {
+            sortedPaths.erase(first, last);
+            generation = NextSelectionGeneration();
+        }
+    }
+
+    void Clear() {
+        if (orderedPaths.empty())
+            return;
+        orderedPaths.clear();
+        selectionOrders.clear();
+        sortedPaths.clear();
+        descendantCounts.clear();
+        generation = NextSelectionGeneration();
+    }
+
+    void RemoveFromIndices(std::unordered_map<SdfPath, size_t, SdfPath::Hash>::iterator found) {
+        for (SdfPath ancestor = found->first.GetParentPath(); !ancestor.IsEmpty(); ancestor = ancestor.GetParentPath()) {
+            const auto count = descendantCounts.find(ancestor);
+            if (--count->second == 0) {
+                descendantCounts.erase(count);
+            }
+        }
+        orderedPaths.erase(found->second);
+        selectionOrders.erase(found);
+    }
+
+    std::map<size_t, SdfPath> orderedPaths;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> selectionOrders;
+    std::set<SdfPath> sortedPaths;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> descendantCounts;
+    size_t nextOrder = 0;
+    SelectionHash generation = 0;
 };
 
-struct Selection::SelectionData {
-    // Selection data for the layers
+/// Selected specs of a layer
+struct LayerSelection {
     // Instead of keeping selected path for the layers, we keep handles as the paths can change when the prims are renamed or
     // moved and it invalidates the selection. The handles on spec stays consistent with renaming and moving
-    std::unordered_set<SdfSpecHandle> _sdfPrimSelectionDomain;
+    std::unordered_set<SdfSpecHandle> primSelectionDomain;
+    std::unordered_set<SdfSpecHandle> propSelectionDomain;
+};
 
-    std::unordered_set<SdfSpecHandle> _sdfPropSelectionDomain;
+/// Selections of the owners, layers or stages. They are kept when the editor switches between owners.
+/// There are only a few opened stages and edited layers, so the owners are found with a linear search, and the selections
+/// of the expired owners are removed when a new owner is added.
+template <typename OwnerT, typename SelectionT> struct OwnerSelections {
+    template <typename OtherOwnerT> const SelectionT *Find(const OtherOwnerT &owner) const {
+        for (const auto &ownerSelection : selections) {
+            if (get_pointer(ownerSelection.first) == get_pointer(owner)) {
+                return &ownerSelection.second;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename OtherOwnerT> SelectionT &Get(const OtherOwnerT &owner) {
+        if (const SelectionT *selection = Find(owner)) {
+            return const_cast<SelectionT &>(*selection);
+        }
+        selections.erase(std::remove_if(selections.begin(), selections.end(),
+                                        [](const std::pair<OwnerT, SelectionT> &ownerSelection) { return !ownerSelection.first; }),
+                         selections.end());
+        selections.emplace_back(OwnerT(owner), SelectionT());
+        return selections.back().second;
+    }
+
+    std::vector<std::pair<OwnerT, SelectionT>> selections;
+};
+
+struct Selection::SelectionData {
+    // Selection data for the layers
+    OwnerSelections<SdfLayerHandle, LayerSelection> _layerSelections;
 
     // Selection data for the stages
-    // TODO: keep an anchor, basically the first selected prim, we would need a list to keep the order
-    StageSelection _stageSelection;
+    OwnerSelections<UsdStageWeakPtr, StageSelection> _stageSelections;
 };
 
 Selection::Selection() { _data = new SelectionData(); }
@@ -57,24 +148,24 @@ Selection::~Selection() { delete _data; }
 template <> void Selection::Clear(const SdfLayerRefPtr &layer) {
     if (!_data || !layer)
         return;
-    _data->_sdfPrimSelectionDomain.clear();
+    _data->_layerSelections.Get(layer).primSelectionDomain.clear();
 }
 
 template <> void Selection::Clear(const UsdStageRefPtr &stage) {
     if (!_data || !stage)
         return;
-    _data->_stageSelection.reset(new HdSelection());
-    _data->_stageSelection.mustRecomputeHash = true;
+    _data->_stageSelections.Get(stage).Clear();
 }
 
 // Layer add a selection
 template <> void Selection::AddSelected(const SdfLayerRefPtr &layer, const SdfPath &selectedPath) {
     if (!_data || !layer)
         return;
+    LayerSelection &layerSelection = _data->_layerSelections.Get(layer);
     if (selectedPath.IsPropertyPath()) {
-        _data->_sdfPropSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
+        layerSelection.propSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
     } else {
-        _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
+        layerSelection.primSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
     }
 }
 
@@ -82,33 +173,34 @@ template <> void Selection::AddSelected(const SdfLayerRefPtr &layer, const SdfPa
     template <> void Selection::AddSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        if (!_data->_stageSelection) {                                                                                           \
-            _data->_stageSelection.reset(new HdSelection());                                                                     \
-        }                                                                                                                        \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
+        _data->_stageSelections.Get(stage).Add(selectedPath);                                                                    \
     }
 
 ImplementStageAddSelected(UsdStageRefPtr);
 ImplementStageAddSelected(UsdStageWeakPtr);
 
-// Not called at the moment
-template <> void Selection::RemoveSelected(const UsdStageWeakPtr &stage, const SdfPath &path) {
-    if (!_data || !stage)
-        return;
-}
+#define ImplementStageRemoveSelected(StageT)                                                                                     \
+    template <> void Selection::RemoveSelected(const StageT &stage, const SdfPath &path) {                                       \
+        if (!_data || !stage)                                                                                                    \
+            return;                                                                                                              \
+        _data->_stageSelections.Get(stage).Remove(path);                                                                         \
+    }
+
+ImplementStageRemoveSelected(UsdStageRefPtr);
+ImplementStageRemoveSelected(UsdStageWeakPtr);
 
 #define ImplementLayerSetSelected(LayerT)                                                                                        \
     template <> void Selection::SetSelected(const LayerT &layer, const SdfPath &selectedPath) {                                  \
         if (!_data || !layer)                                                                                                    \
             return;                                                                                                              \
-        _data->_sdfPrimSelectionDomain.clear();                                                                                  \
-        _data->_sdfPropSelectionDomain.clear();                                                                                  \
+        LayerSelection &layerSelection = _data->_layerSelections.Get(layer);                                                     \
+        layerSelection.primSelectionDomain.clear();                                                                              \
+        layerSelection.propSelectionDomain.clear();                                                                              \
         if (selectedPath.IsPropertyPath()) {                                                                                     \
-            _data->_sdfPropSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                         \
-            _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath.GetPrimOrPrimVariantSelectionPath()));     \
+            layerSelection.propSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                     \
+            layerSelection.primSelectionDomain.insert(layer->GetObjectAtPath(selectedPath.GetPrimOrPrimVariantSelectionPath())); \
         } else {                                                                                                                 \
-            _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                         \
+            layerSelection.primSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                     \
         }                                                                                                                        \
     }
 
@@ -119,9 +211,11 @@ ImplementLayerSetSelected(SdfLayerHandle);
     template <> void Selection::SetSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        _data->_stageSelection.reset(new HdSelection());                                                                         \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
+        StageSelection &stageSelection = _data->_stageSelections.Get(stage);                                                     \
+        if (stageSelection.orderedPaths.size() == 1 && stageSelection.orderedPaths.begin()->second == selectedPath)              \
+            return;                                                                                                              \
+        stageSelection.Clear();                                                                                                  \
+        stageSelection.Add(selectedPath);                                                                                        \
     }
 
 ImplementStageSetSelected(UsdStageRefPtr);
@@ -131,7 +225,9 @@ ImplementStageSetSelected(UsdStageWeakPtr);
     template <> bool Selection::IsSelectionEmpty(const LayerT &layer) const {                                                    \
         if (!_data || !layer)                                                                                                    \
             return true;                                                                                                         \
-        return _data->_sdfPrimSelectionDomain.empty() && _data->_sdfPropSelectionDomain.empty();                                 \
+        const LayerSelection *layerSelection = _data->_layerSelections.Find(layer);                                              \
+        return !layerSelection ||                                                                                                \
+               (layerSelection->primSelectionDomain.empty() && layerSelection->propSelectionDomain.empty());                     \
     }
 
 ImplementLayerIsSelectionEmpty(SdfLayerHandle);
@@ -141,7 +237,8 @@ ImplementLayerIsSelectionEmpty(SdfLayerRefPtr);
     template <> bool Selection::IsSelectionEmpty(const StageT &stage) const {                                                    \
         if (!_data || !stage)                                                                                                    \
             return true;                                                                                                         \
-        return !_data->_stageSelection || _data->_stageSelection->IsEmpty();                                                     \
+        const StageSelection *stageSelection = _data->_stageSelections.Find(stage);                                              \
+        return !stageSelection || stageSelection->orderedPaths.empty();                                                          \
     }
 
 ImplementStageIsSelectionEmpty(UsdStageRefPtr);
@@ -150,37 +247,79 @@ ImplementStageIsSelectionEmpty(UsdStageWeakPtr);
 template <> bool Selection::IsSelected(const SdfPrimSpecHandle &spec) const {
     if (!_data || !spec)
         return false;
-    return _data->_sdfPrimSelectionDomain.find(spec) != _data->_sdfPrimSelectionDomain.end();
+    const LayerSelection *layerSelection = _data->_layerSelections.Find(spec->GetLayer());
+    return layerSelection && layerSelection->primSelectionDomain.find(spec) != layerSelection->primSelectionDomain.end();
 }
 
 template <> bool Selection::IsSelected(const SdfAttributeSpecHandle &spec) const {
     if (!_data || !spec)
         return false;
-    return _data->_sdfPropSelectionDomain.find(spec) != _data->_sdfPropSelectionDomain.end();
+    const LayerSelection *layerSelection = _data->_layerSelections.Find(spec->GetLayer());
+    return layerSelection && layerSelection->propSelectionDomain.find(spec) != layerSelection->propSelectionDomain.end();
 }
 
-template <> bool Selection::IsSelected(const UsdStageWeakPtr &stage, const SdfPath &selectedPath) const {
+#define ImplementStageIsSelected(StageT)                                                                                         \
+    template <> bool Selection::IsSelected(const StageT &stage, const SdfPath &selectedPath) const {                             \
+        if (!_data || !stage)                                                                                                    \
+            return false;                                                                                                        \
+        const StageSelection *stageSelection = _data->_stageSelections.Find(stage);                                              \
+        return stageSelection && stageSelection->selectionOrders.count(selectedPath) != 0;                                       \
+    }
+
+ImplementStageIsSelected(UsdStageRefPtr);
+ImplementStageIsSelected(UsdStageWeakPtr);
+
+#define ImplementStageHasSelectedDescendant(StageT)                                                                              \
+    template <> bool Selection::HasSelectedDescendant(const StageT &stage, const SdfPath &path) const {                          \
+        if (!_data || !stage)                                                                                                    \
+            return false;                                                                                                        \
+        const StageSelection *stageSelection = _data->_stageSelections.Find(stage);                                              \
+        return stageSelection && stageSelection->descendantCounts.count(path) != 0;                                              \
+    }
+
+ImplementStageHasSelectedDescendant(UsdStageRefPtr);
+ImplementStageHasSelectedDescendant(UsdStageWeakPtr);
+
+template <> std::vector<SdfPath> Selection::GetAncestorPaths(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
-        return false;
-    if (_data->_stageSelection) {
-        if (_data->_stageSelection->GetPrimSelectionState(HdSelection::HighlightModeSelect, selectedPath)) {
-            return true;
+        return {};
+    const StageSelection *stageSelection = _data->_stageSelections.Find(stage);
+    if (!stageSelection)
+        return {};
+    std::vector<SdfPath> paths;
+    paths.reserve(stageSelection->descendantCounts.size());
+    for (const auto &ancestor : stageSelection->descendantCounts) {
+        paths.push_back(ancestor.first);
+    }
+    return paths;
+}
+
+template <> void Selection::AddSelectedSubtree(const UsdStageRefPtr &stage, const SdfPath &path) {
+    if (!_data || !stage)
+        return;
+    if (const UsdPrim root = stage->GetPrimAtPath(path)) {
+        StageSelection &stageSelection = _data->_stageSelections.Get(stage);
+        for (const UsdPrim &prim : UsdPrimRange(root, UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate))) {
+            stageSelection.Add(prim.GetPath());
         }
     }
-    return false;
 }
 
+template <> void Selection::RemoveSelectedSubtree(const UsdStageRefPtr &stage, const SdfPath &path) {
+    if (!_data || !stage)
+        return;
+    _data->_stageSelections.Get(stage).RemoveSubtree(path);
+}
+
+// The generations are unique among all the stages, so a widget switching to a different stage finds a different
+// generation, unless it keeps the last generation of each stage.
 template <> bool Selection::UpdateSelectionHash(const UsdStageRefPtr &stage, SelectionHash &lastSelectionHash) {
     if (!_data || !stage)
         return false;
-
-    if (_data->_stageSelection && _data->_stageSelection.mustRecomputeHash) {
-        auto paths = _data->_stageSelection->GetAllSelectedPrimPaths();
-        _data->_stageSelection.selectionHash = std::hash<SdfPathVector>{}(paths);
-    }
-
-    if (_data->_stageSelection.selectionHash != lastSelectionHash) {
-        lastSelectionHash = _data->_stageSelection.selectionHash;
+    const StageSelection *stageSelection = _data->_stageSelections.Find(stage);
+    const SelectionHash generation = stageSelection ? stageSelection->generation : 0;
+    if (generation != lastSelectionHash) {
+        lastSelectionHash = generation;
         return true;
     }
     return false;
@@ -190,8 +329,9 @@ template <> bool Selection::UpdateSelectionHash(const UsdStageRefPtr &stage, Sel
 template <> SdfPath Selection::GetAnchorPrimPath(const LayerT &layer) const {\
     if (!_data || !layer)\
         return {};\
-    if (!_data->_sdfPrimSelectionDomain.empty()) {\
-        const auto firstPrimHandle = *_data->_sdfPrimSelectionDomain.begin();\
+    const LayerSelection *layerSelection = _data->_layerSelections.Find(layer);\
+    if (layerSelection && !layerSelection->primSelectionDomain.empty()) {\
+        const auto firstPrimHandle = *layerSelection->primSelectionDomain.begin();\
         if (firstPrimHandle) {\
             return firstPrimHandle->GetPath();\
         }\
@@ -206,8 +346,9 @@ ImplementGetAnchorPrimPath(SdfLayerRefPtr);
 template <> SdfPath Selection::GetAnchorPropertyPath(const LayerT &layer) const {\
     if (!_data || !layer)\
         return {};\
-    if (!_data->_sdfPropSelectionDomain.empty()) {\
-        const   auto firstPrimHandle = *_data->_sdfPropSelectionDomain.begin();\
+    const LayerSelection *layerSelection = _data->_layerSelections.Find(layer);\
+    if (layerSelection && !layerSelection->propSelectionDomain.empty()) {\
+        const   auto firstPrimHandle = *layerSelection->propSelectionDomain.begin();\
         if (firstPrimHandle) {\
             return firstPrimHandle->GetPath();\
         }\
@@ -222,32 +363,35 @@ ImplementGetAnchorPropertyPath(SdfLayerRefPtr);
 template <> SdfPath Selection::GetAnchorPrimPath(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        const auto &paths = _data->_stageSelection->GetSelectedPrimPaths(HdSelection::HighlightModeSelect);
-        if (!paths.empty()) {
-            return paths[0];
-        }
-    }
-    return {};
+    const StageSelection *stageSelection = _data->_stageSelections.Find(stage);
+    return stageSelection && !stageSelection->orderedPaths.empty() ? stageSelection->orderedPaths.begin()->second : SdfPath();
 }
 
 // This is called only once when there is a drag and drop at the moment
 template <> std::vector<SdfPath> Selection::GetSelectedPaths(const SdfLayerHandle &layer) const {
     if (!_data || !layer)
         return {};
+    const LayerSelection *layerSelection = _data->_layerSelections.Find(layer);
+    if (!layerSelection)
+        return {};
     std::vector<SdfPath> paths;
-    std::transform(_data->_sdfPrimSelectionDomain.begin(), _data->_sdfPrimSelectionDomain.end(), std::back_inserter(paths),
-                   [](const SdfSpecHandle &p) { return p->GetPath(); });
-    std::transform(_data->_sdfPropSelectionDomain.begin(), _data->_sdfPropSelectionDomain.end(), std::back_inserter(paths),
-                   [](const SdfSpecHandle &p) { return p->GetPath(); });
+    std::transform(layerSelection->primSelectionDomain.begin(), layerSelection->primSelectionDomain.end(),
+                   std::back_inserter(paths), [](const SdfSpecHandle &p) { return p->GetPath(); });
+    std::transform(layerSelection->propSelectionDomain.begin(), layerSelection->propSelectionDomain.end(),
+                   std::back_inserter(paths), [](const SdfSpecHandle &p) { return p->GetPath(); });
     return paths;
 }
 
 template <> std::vector<SdfPath> Selection::GetSelectedPaths(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        return _data->_stageSelection->GetAllSelectedPrimPaths();
+    const StageSelection *stageSelection = _data->_stageSelections.Find(stage);
+    if (!stageSelection)
+        return {};
+    std::vector<SdfPath> paths;
+    paths.reserve(stageSelection->orderedPaths.size());
+    for (const auto &orderedPath : stageSelection->orderedPaths) {
+        paths.push_back(orderedPath.second);
     }
-    return {};
+    return paths;
 }
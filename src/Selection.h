@@ -11,6 +11,7 @@ PXR_NAMESPACE_USING_DIRECTIVE
 /// managing its own selection mechanism
 ///
 
+/// Version of a selection, it changes every time the selection is modified
 using SelectionHash = std::size_t;
 
 struct Selection {
@@ -18,8 +19,7 @@ struct Selection {
     Selection();
     ~Selection();
 
-    // The selections are store by Owners which are Layers or Stages, meaning each layer should have its own selection
-    // at some point. The API allows it, the code doesn't yet.
+    // The selections are store by Owners which are Layers or Stages, each layer and each stage has its own selection.
     // An Item is a combination of a Owner + SdfPath. If the stage is the Owner, then the Item is a UsdPrim
 
     template <typename OwnerT> void Clear(const OwnerT &);
@@ -29,11 +29,20 @@ struct Selection {
     template <typename OwnerT> bool IsSelectionEmpty(const OwnerT &) const;
     template <typename OwnerT> bool IsSelected(const OwnerT &, const SdfPath &path) const;
     template <typename ItemT> bool IsSelected(const ItemT &) const;
+    /// Returns true if the selection has changed since lastSelectionHash was updated, and updates it
     template <typename OwnerT> bool UpdateSelectionHash(const OwnerT &, SelectionHash &lastSelectionHash);
     template <typename OwnerT> SdfPath GetAnchorPrimPath(const OwnerT &) const;
     template <typename OwnerT> SdfPath GetAnchorPropertyPath(const OwnerT &) const;
     template <typename OwnerT> std::vector<SdfPath> GetSelectedPaths(const OwnerT &) const;
 
+    // Hierarchy queries, the descendants are strict
+    template <typename OwnerT> bool HasSelectedDescendant(const OwnerT &, const SdfPath &path) const;
+    /// Returns the paths having selected descendants
+    template <typename OwnerT> std::vector<SdfPath> GetAncestorPaths(const OwnerT &) const;
+    /// Select or deselect a path and all its descendants
+    template <typename OwnerT> void AddSelectedSubtree(const OwnerT &, const SdfPath &path);
+    template <typename OwnerT> void RemoveSelectedSubtree(const OwnerT &, const SdfPath &path);
+
     // private:
     struct SelectionData;
     SelectionData *_data;
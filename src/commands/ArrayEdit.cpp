@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/gf/matrix2d.h>
+#include <pxr/base/gf/matrix2f.h>
+#include <pxr/base/gf/matrix3d.h>
+#include <pxr/base/gf/matrix3f.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/quatd.h>
+#include <pxr/base/gf/quatf.h>
+#include <pxr/base/gf/quath.h>
+#include <pxr/base/gf/vec2d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec2h.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec3h.h>
+#include <pxr/base/gf/vec3i.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/gf/vec4h.h>
+#include <pxr/base/gf/vec4i.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/sdf/assetPath.h>
+
+#include "ArrayEdit.h"
+
+template <typename ValueT> static bool ApplyToArray(const ArrayEdit &edit, VtArray<ValueT> &array, ArrayEdit &inverse) {
+    const size_t size = array.size();
+    if (edit.operation == ArrayEdit::SetElement || edit.operation == ArrayEdit::InsertElement) {
+        if (!edit.element.IsHolding<ValueT>())
+            return false;
+    }
+    switch (edit.operation) {
+    case ArrayEdit::SetElement:
+        if (edit.index >= size)
+            return false;
+        inverse = ArrayEdit{ArrayEdit::SetElement, edit.index, 0, VtValue(array[edit.index])};
+        array[edit.index] = edit.element.UncheckedGet<ValueT>();
+        return true;
+    case ArrayEdit::InsertElement:
+        if (edit.index > size)
+            return false;
+        inverse = ArrayEdit{ArrayEdit::EraseElement, edit.index, 0, VtValue()};
+        array.resize(size + 1);
+        std::move_backward(array.begin() + edit.index, array.begin() + size, array.end());
+        array[edit.index] = edit.element.UncheckedGet<ValueT>();
+        return true;
+    case ArrayEdit::EraseElement:
+        if (edit.index >= size)
+            return false;
+        inverse = ArrayEdit{ArrayEdit::InsertElement, edit.index, 0, VtValue(array[edit.index])};
+        array.erase(array.begin() + edit.index);
+        return true;
+    case ArrayEdit::SwapElements:
+        if (edit.index >= size || edit.otherIndex >= size)
+            return false;
+        inverse = edit;
+        std::swap(array[edit.index], array[edit.otherIndex]);
+        return true;
+    }
+    return false;
+}
+
+// The array is moved out of the value so it is edited in place when the value is its only owner
+template <typename ValueT> static bool ApplyToValue(const ArrayEdit &edit, VtValue &value, ArrayEdit &inverse) {
+    VtArray<ValueT> array;
+    value.Swap(array);
+    const bool applied = ApplyToArray(edit, array, inverse);
+    value.Swap(array);
+    return applied;
+}
+
+#define ApplyIfHolding(ValueT)                                                                                                   \
+    if (value.IsHolding<VtArray<ValueT>>()) {                                                                                    \
+        return ApplyToValue<ValueT>(*this, value, inverse);                                                                      \
+    }
+
+bool ArrayEdit::Apply(VtValue &value, ArrayEdit &inverse) const {
+    // Same types as the array editor
+    // clang-format off
+    ApplyIfHolding(GfVec2f)
+    ApplyIfHolding(GfVec3f)
+    ApplyIfHolding(GfVec4f)
+    ApplyIfHolding(GfVec2d)
+    ApplyIfHolding(GfVec3d)
+    ApplyIfHolding(GfVec4d)
+    ApplyIfHolding(GfVec2i)
+    ApplyIfHolding(GfVec3i)
+    ApplyIfHolding(GfVec4i)
+    ApplyIfHolding(bool)
+    ApplyIfHolding(float)
+    ApplyIfHolding(double)
+    ApplyIfHolding(char)
+    ApplyIfHolding(unsigned char)
+    ApplyIfHolding(int)
+    ApplyIfHolding(unsigned int)
+    ApplyIfHolding(int64_t)
+    ApplyIfHolding(uint64_t)
+    ApplyIfHolding(GfHalf)
+    ApplyIfHolding(TfToken)
+    ApplyIfHolding(SdfAssetPath)
+    ApplyIfHolding(GfMatrix4d)
+    ApplyIfHolding(GfMatrix4f)
+    ApplyIfHolding(GfMatrix3d)
+    ApplyIfHolding(GfMatrix3f)
+    ApplyIfHolding(GfMatrix2d)
+    ApplyIfHolding(GfMatrix2f)
+    ApplyIfHolding(std::string)
+    ApplyIfHolding(GfVec2h)
+    ApplyIfHolding(GfVec3h)
+    ApplyIfHolding(GfVec4h)
+    ApplyIfHolding(GfQuath)
+    ApplyIfHolding(GfQuatf)
+    ApplyIfHolding(GfQuatd)
+    // clang-format on
+    return false;
+}
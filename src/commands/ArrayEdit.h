@@ -0,0 +1,22 @@
+#pragma once
+#include <pxr/base/vt/value.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Sparse edition of an array value: an element is set, inserted or erased, or two elements are swapped.
+/// It is used to edit and undo large arrays without copying them.
+///
+struct ArrayEdit {
+    enum Operation { SetElement, InsertElement, EraseElement, SwapElements };
+
+    Operation operation = SetElement;
+    size_t index = 0;
+    size_t otherIndex = 0; // Swapped element
+    VtValue element;       // Set or inserted element
+
+    /// Apply the edit on the array held by value, in place if the array is not shared.
+    /// Returns false if the array type doesn't match the element or an index is out of range.
+    /// inverse receives the edit reverting this one.
+    bool Apply(VtValue &value, ArrayEdit &inverse) const;
+};
@@ -4,9 +4,11 @@
 #include <pxr/usd/usdGeom/gprim.h>
 #include <pxr/usd/sdf/propertySpec.h>
 #include <pxr/base/vt/value.h>
+#include "ArrayEdit.h"
 #include "CommandsImpl.h"
 #include "CommandStack.h"
 #include "SdfCommandGroupRecorder.h"
+#include "SdfLayerInstructions.h"
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
@@ -119,3 +121,28 @@ struct RelationshipReplace : public SdfLayerCommand {
     SdfPath _after;
 };
 template void ExecuteAfterDraw<RelationshipReplace>(UsdRelationship rel, SdfPath before, SdfPath after);
+
+/// Edit one element of the array held by the default value or a time sample of an attribute spec.
+/// The edit is recorded as a sparse instruction, the arrays are not copied in the undo stack.
+struct AttributeEditArray : public SdfLayerCommand {
+    AttributeEditArray(SdfLayerHandle layer, SdfPath path, UsdTimeCode timeCode, ArrayEdit edit)
+        : _layer(layer), _path(path), _timeCode(timeCode), _edit(std::move(edit)) {}
+
+    bool DoIt() override {
+        if (_undoCommands.IsEmpty()) {
+            UndoRedoArrayEdit instruction(_layer, _path, _timeCode.IsDefault(), _timeCode.GetValue(), _edit);
+            if (!instruction.DoIt())
+                return false;
+            _undoCommands.StoreInstruction(std::move(instruction));
+        } else {
+            _undoCommands.DoIt();
+        }
+        return true;
+    }
+
+    SdfLayerHandle _layer;
+    SdfPath _path;
+    UsdTimeCode _timeCode;
+    ArrayEdit _edit;
+};
+template void ExecuteAfterDraw<AttributeEditArray>(SdfLayerHandle layer, SdfPath path, UsdTimeCode timeCode, ArrayEdit edit);
@@ -1,5 +1,7 @@
 #include "CommandStack.h"
 #include "SdfCommandGroupRecorder.h"
+#include <algorithm>
+#include <chrono>
 
 CommandStack *CommandStack::instance = nullptr;
 
@@ -17,23 +19,171 @@ CommandStack::~CommandStack() {
     }
 }
 
+/// Commands executed as a single undo step
+struct CommandBatch : public Command {
+    CommandBatch() {}
+    ~CommandBatch() override {
+        for (Command *command : _pendingCommands) {
+            delete command;
+        }
+    }
+
+    bool DoIt() override;
+    bool UndoIt() override;
+
+    size_t GetMemoryFootprint() const override {
+        size_t footprint = sizeof(CommandBatch);
+        for (const auto &command : _commands) {
+            footprint += command->GetMemoryFootprint();
+        }
+        return footprint;
+    }
+
+    size_t SpillToFile() override {
+        size_t releasedBytes = 0;
+        for (auto &command : _commands) {
+            releasedBytes += command->SpillToFile();
+        }
+        return releasedBytes;
+    }
+
+    bool IsEdition() const override {
+        return std::any_of(_pendingCommands.begin(), _pendingCommands.end(),
+                           [](const Command *command) { return command->IsEdition(); }) ||
+               std::any_of(_commands.begin(), _commands.end(), [](const auto &command) { return command->IsEdition(); });
+    }
+
+    // Commands waiting for their first execution
+    std::vector<Command *> _pendingCommands;
+
+    // Commands executed and pushed on the stack, they are undone in the reverse order
+    CommandStack::UndoStackT _commands;
+};
+
+bool CommandBatch::DoIt() {
+    if (_pendingCommands.empty()) { // Redo
+        for (auto &command : _commands) {
+            command->DoIt();
+        }
+        return !_commands.empty();
+    }
+    // The commands pushed by the pending commands are recorded in this batch instead of the undo stack
+    CommandStack &commandStack = CommandStack::GetInstance();
+    CommandBatch *previousBatch = commandStack.executingBatch;
+    commandStack.executingBatch = this;
+    for (Command *command : _pendingCommands) {
+        if (command->DoIt()) {
+            commandStack._PushCommand(command);
+        } else {
+            delete command;
+        }
+    }
+    _pendingCommands.clear();
+    commandStack.executingBatch = previousBatch;
+    return !_commands.empty();
+}
+
+bool CommandBatch::UndoIt() {
+    for (auto command = _commands.rbegin(); command != _commands.rend(); ++command) {
+        (*command)->UndoIt();
+    }
+    return false;
+}
+
+void CommandStack::SetNextCommand(Command *command) {
+    if (openBatch) {
+        openBatch->_pendingCommands.push_back(command);
+    } else {
+        pendingCommands.push_back(command);
+    }
+}
+
+void CommandStack::BeginBatch() {
+    // Nested batches are merged in the outer one
+    if (openBatchDepth++ == 0) {
+        openBatch = new CommandBatch();
+    }
+}
+
+void CommandStack::EndBatch() {
+    if (openBatchDepth == 0 || --openBatchDepth > 0)
+        return;
+    if (openBatch->_pendingCommands.empty()) {
+        delete openBatch;
+    } else {
+        pendingCommands.push_back(openBatch);
+    }
+    openBatch = nullptr;
+}
+
 void CommandStack::ExecuteCommands() {
-    if (lastCmd) {
-        if (lastCmd->DoIt()) {
-            _PushCommand(lastCmd);
+    if (pendingCommands.empty())
+        return;
+    // The selection commands only read the stages, the searches running in the background are not interrupted
+    if (std::any_of(pendingCommands.begin(), pendingCommands.end(),
+                    [](const Command *command) { return command->IsEdition(); })) {
+        CallBeforeEditionCallbacks();
+    }
+    // The commands queued while executing this frame commands are executed at the next frame
+    std::vector<Command *> commands;
+    commands.swap(pendingCommands);
+    for (Command *command : commands) {
+        if (command->DoIt()) {
+            _PushCommand(command);
         } else {
-            delete lastCmd;
+            delete command;
+        }
+    }
+}
+
+size_t CommandStack::GetMemoryFootprint() const {
+    size_t footprint = 0;
+    for (const auto &command : undoStack) {
+        footprint += command->GetMemoryFootprint();
+    }
+    return footprint;
+}
+
+void CommandStack::SetMemoryBudget(size_t memoryBudget, bool spillToFile) {
+    _memoryBudget = memoryBudget;
+    _spillToFile = spillToFile;
+    EnforceMemoryBudget();
+}
+
+// The oldest commands are spilled to disk first, then removed from the stack. The last command is always kept.
+void CommandStack::EnforceMemoryBudget() {
+    if (_memoryBudget == 0 || undoStack.size() < 2)
+        return;
+    size_t footprint = GetMemoryFootprint();
+    if (footprint <= _memoryBudget)
+        return;
+    if (_spillToFile) {
+        for (size_t i = 0; i + 1 < undoStack.size() && footprint > _memoryBudget; ++i) {
+            footprint -= undoStack[i]->SpillToFile();
         }
-        lastCmd = nullptr; // Reset the command
+    }
+    size_t removedCount = 0;
+    while (footprint > _memoryBudget && removedCount + 1 < undoStack.size() && removedCount < static_cast<size_t>(undoStackPos)) {
+        footprint -= undoStack[removedCount]->GetMemoryFootprint();
+        removedCount++;
+    }
+    if (removedCount) {
+        undoStack.erase(undoStack.begin(), undoStack.begin() + removedCount);
+        undoStackPos -= static_cast<int>(removedCount);
     }
 }
 
 void CommandStack::_PushCommand(Command *cmd) {
+    if (executingBatch) {
+        executingBatch->_commands.emplace_back(cmd);
+        return;
+    }
     if (undoStackPos != undoStack.size()) {
         undoStack.resize(undoStackPos);
     }
     undoStack.emplace_back(std::move(cmd));
     undoStackPos++;
+    EnforceMemoryBudget();
 }
 
 struct UndoCommand : public Command {
@@ -72,8 +222,11 @@ bool UndoCommand::DoIt() {
     CommandStack &commandStack = CommandStack::GetInstance();
     // TODO : move into stacK ??
     if (commandStack.undoStackPos > 0) {
+        const auto start = std::chrono::steady_clock::now();
         commandStack.undoStackPos--;
         commandStack.undoStack[commandStack.undoStackPos]->UndoIt();
+        commandStack._lastUndoRedoMilliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
     return false; // Should never be stored in the stack
 }
@@ -85,8 +238,11 @@ bool RedoCommand::DoIt() {
     // TODO : move into stacK ??
     CommandStack &commandStack = CommandStack::GetInstance();
     if (commandStack.undoStackPos < commandStack.undoStack.size()) {
+        const auto start = std::chrono::steady_clock::now();
         commandStack.undoStack[commandStack.undoStackPos]->DoIt();
         commandStack.undoStackPos++;
+        commandStack._lastUndoRedoMilliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 
     return false; // Should never be stored in the stack
@@ -99,8 +255,6 @@ bool ClearUndoRedoCommand::DoIt() {
     CommandStack &commandStack = CommandStack::GetInstance();
     commandStack.undoStackPos = 0;
     commandStack.undoStack.clear();
-    delete commandStack.lastCmd;
-    commandStack.lastCmd = nullptr;
     return false; // Should never be stored in the stack
 }
 template void ExecuteAfterDraw<ClearUndoRedoCommand>();
@@ -109,7 +263,10 @@ template void ExecuteAfterDraw<ClearUndoRedoCommand>();
 bool UsdFunctionCall::DoIt() {
     CommandStack &commandStack = CommandStack::GetInstance();
     SdfUndoRedoCommand *command = new SdfUndoRedoCommand();
-    {
+    if (_stage) {
+        SdfCommandGroupRecorder recorder(command->_undoCommands, _stage);
+        _func();
+    } else {
         SdfCommandGroupRecorder recorder(command->_undoCommands, _layer);
         _func();
     }
@@ -121,11 +278,8 @@ bool UsdFunctionCall::DoIt() {
     return false;
 }
 
-template <> UsdFunctionCall::UsdFunctionCall(UsdStageRefPtr stage, std::function<void()> func) : _layer(), _func(func) {
-    if (stage) { // I am assuming the edits always go in the edit target layer
-        _layer = stage->GetEditTarget().GetLayer();
-    }
-}
+template <>
+UsdFunctionCall::UsdFunctionCall(UsdStageRefPtr stage, std::function<void()> func) : _layer(), _stage(stage), _func(func) {}
 
 template void ExecuteAfterDraw<UsdFunctionCall>(SdfLayerRefPtr layer, std::function<void()> func);
 template void ExecuteAfterDraw<UsdFunctionCall>(SdfLayerHandle layer, std::function<void()> func);
@@ -136,3 +290,17 @@ template void ExecuteAfterDraw<UsdFunctionCall>(UsdStageRefPtr stage, std::funct
 void ExecuteCommands() {
     CommandStack::GetInstance().ExecuteCommands();
 }
+
+void BeginCommandBatch() { CommandStack::GetInstance().BeginBatch(); }
+
+void EndCommandBatch() { CommandStack::GetInstance().EndBatch(); }
+
+size_t GetUndoStackSize() { return CommandStack::GetInstance().undoStack.size(); }
+
+size_t GetUndoStackMemoryFootprint() { return CommandStack::GetInstance().GetMemoryFootprint(); }
+
+double GetLastUndoRedoMilliseconds() { return CommandStack::GetInstance().GetLastUndoRedoMilliseconds(); }
+
+void SetUndoStackMemoryBudget(size_t memoryBudget, bool spillToFile) {
+    CommandStack::GetInstance().SetMemoryBudget(memoryBudget, spillToFile);
+}
@@ -4,6 +4,8 @@
 
 #include "CommandsImpl.h"
 
+struct CommandBatch;
+
 struct CommandStack {
 
     // Undo and Redo calls are implemented as commands.
@@ -16,15 +18,32 @@ struct CommandStack {
     //
     friend struct UsdFunctionCall;
     friend class SdfUndoRedoRecorder;
-    
+    friend struct CommandBatch;
+
     static CommandStack &GetInstance();
 
-    inline bool HasNextCommand() { return lastCmd != nullptr; }
-    inline void SetNextCommand(Command *command) { lastCmd = command; }
-    
-    // Execute next command and push it on the stack
+    inline bool HasNextCommand() { return !pendingCommands.empty(); }
+
+    /// Queue a command, or add it to the open batch. The command now belongs to this stack
+    void SetNextCommand(Command *command);
+
+    /// The commands queued between BeginBatch and EndBatch are executed as a single undo step
+    void BeginBatch();
+    void EndBatch();
+
+    // Execute the queued commands in order and push them on the stack
     void ExecuteCommands();
-    
+
+    /// Estimated memory used by the undo stack, in bytes
+    size_t GetMemoryFootprint() const;
+
+    /// Maximum memory of the undo stack in bytes, 0 for no limit. When the budget is exceeded, the oldest commands
+    /// are spilled to temporary files if spillToFile is true, and then removed from the stack
+    void SetMemoryBudget(size_t memoryBudget, bool spillToFile);
+
+    /// Duration of the last undo or redo, in milliseconds
+    double GetLastUndoRedoMilliseconds() const { return _lastUndoRedoMilliseconds; }
+
 private:
 
 
@@ -35,11 +54,22 @@ private:
     /// The pointer to the current command in the undo stack
     int undoStackPos = 0;
 
-    // Storing only one command per frame for now, easier to reason about.
-    Command *lastCmd = nullptr;
+    // Commands queued during the frame
+    std::vector<Command *> pendingCommands;
+
+    // Batch receiving the queued commands, and batch recording the executed commands instead of the undo stack
+    CommandBatch *openBatch = nullptr;
+    int openBatchDepth = 0;
+    CommandBatch *executingBatch = nullptr;
+
+    void EnforceMemoryBudget();
+    size_t _memoryBudget = 0;
+    bool _spillToFile = false;
+
+    double _lastUndoRedoMilliseconds = 0.0;
 
     /// The ProcessCommands function is called after the frame is rendered and displayed and execute the
-    /// last command. The command passed here now belongs to this stack
+    /// queued commands. The command passed here now belongs to this stack, or to the executing batch
     void _PushCommand(Command *cmd);
 
   private:
@@ -51,7 +81,5 @@ private:
 /// Dispatching Commands.
 template <typename CommandClass, typename... ArgTypes> void ExecuteAfterDraw(ArgTypes... arguments) {
     CommandStack &commandStack = CommandStack::GetInstance();
-    if (!commandStack.HasNextCommand()) {
-        commandStack.SetNextCommand(new CommandClass(arguments...));
-    }
+    commandStack.SetNextCommand(new CommandClass(arguments...));
 }
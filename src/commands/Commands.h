@@ -48,12 +48,19 @@ struct EditorSetEditTarget;
 struct EditorSetPreviousLayer;
 struct EditorSetNextLayer;
 struct EditorSetSelection;
+struct EditorSelectPaths;
+struct EditorAddSelectedPaths;
+struct EditorRemoveSelectedPaths;
+struct EditorInvertSelection;
+struct EditorAddSelectedSubtree;
+struct EditorRemoveSelectedSubtree;
 struct EditorSelectAttributePath;
 struct EditorShutdown;
 struct EditorStartPlayback;
 struct EditorStopPlayback;
 struct EditorTogglePlayback;
 struct EditorFindPrim;
+struct EditorSelectFoundPrims;
 struct EditorExportUsdz;
 struct EditorExportFlattenedStage;
 
@@ -63,6 +70,7 @@ struct LayerRenameSubLayer;
 struct LayerMute;
 struct LayerUnmute;
 struct LayerTextEdit;
+struct LayerPrimTextEdit;
 struct LayerCreateOversFromPath;
 
 struct ViewportsSelectMouseHoverManipulator;
@@ -77,6 +85,7 @@ struct ClearUndoRedoCommand;
 struct AttributeSet;
 struct AttributeCreateDefaultValue;
 struct AttributeConnect;
+struct AttributeEditArray;
 
 struct RelationshipReplace;
 
@@ -100,8 +109,7 @@ template <typename FuncT, typename... ArgsT> void ExecuteAfterDraw(FuncT &&func,
 
 template <typename FuncT, typename... ArgsT> void ExecuteAfterDraw(FuncT &&func, UsdStageRefPtr stage, ArgsT &&...arguments) {
     std::function<void()> usdApiFunc = std::bind(func, stage, std::forward<ArgsT>(arguments)...);
-    auto layer = TfCreateRefPtrFromProtectedWeakPtr(stage->GetEditTarget().GetLayer());
-    ExecuteAfterDraw<UsdFunctionCall>(layer, usdApiFunc);
+    ExecuteAfterDraw<UsdFunctionCall>(stage, usdApiFunc);
 }
 
 template <typename FuncT, typename... ArgsT> void ExecuteAfterDraw(FuncT &&func, SdfPrimSpecHandle handle, ArgsT &&...arguments) {
@@ -125,7 +133,7 @@ template <typename FuncT, typename... ArgsT> void ExecuteAfterDraw(FuncT &&func,
         std::function<void()> primFunc = std::bind(func, &prim, arguments...);
         primFunc();
     };
-    ExecuteAfterDraw<UsdFunctionCall>(stage->GetEditTarget().GetLayer(), usdApiFunc);
+    ExecuteAfterDraw<UsdFunctionCall>(TfCreateRefPtrFromProtectedWeakPtr(stage), usdApiFunc);
 }
 
 template <typename FuncT, typename... ArgsT>
@@ -137,7 +145,7 @@ void ExecuteAfterDraw(FuncT &&func, const UsdAttribute &attribute, ArgsT &&...ar
         std::function<void()> attributeFunc = std::bind(func, &att, arguments...);
         attributeFunc();
     };
-    ExecuteAfterDraw<UsdFunctionCall>(stage->GetEditTarget().GetLayer(), usdApiFunc);
+    ExecuteAfterDraw<UsdFunctionCall>(TfCreateRefPtrFromProtectedWeakPtr(stage), usdApiFunc);
 }
 
 template <typename FuncT, typename... ArgsT>
@@ -149,7 +157,7 @@ void ExecuteAfterDraw(FuncT &&func, const UsdRelationship &relationship, ArgsT &
         std::function<void()> relationshipFunc = std::bind(func, &relationship, arguments...);
         relationshipFunc();
     };
-    ExecuteAfterDraw<UsdFunctionCall>(stage->GetEditTarget().GetLayer(), usdApiFunc);
+    ExecuteAfterDraw<UsdFunctionCall>(TfCreateRefPtrFromProtectedWeakPtr(stage), usdApiFunc);
 }
 
 template <typename FuncT, typename... ArgsT>
@@ -166,7 +174,7 @@ void ExecuteAfterDraw(FuncT &&func, const UsdVariantSet &variantSet, ArgsT &&...
             variantSetFunc();
         }
     };
-    ExecuteAfterDraw<UsdFunctionCall>(stage->GetEditTarget().GetLayer(), usdApiFunc);
+    ExecuteAfterDraw<UsdFunctionCall>(TfCreateRefPtrFromProtectedWeakPtr(stage), usdApiFunc);
 }
 
 
@@ -207,7 +215,7 @@ void ExecuteAfterDraw(FuncT &&func, const UsdGeomXformCommonAPI &api, ArgsT &&..
                 apiFunc();
             }
         };
-        ExecuteAfterDraw<UsdFunctionCall>(stage->GetEditTarget().GetLayer(), usdApiFunc);
+        ExecuteAfterDraw<UsdFunctionCall>(TfCreateRefPtrFromProtectedWeakPtr(stage), usdApiFunc);
     }
 }
 
@@ -238,9 +246,26 @@ void ExecuteAfterDraw(FuncT &&func, const UsdGeomXformCommonAPI &api, ArgsT &&..
 //// We could simply copy the handle/ref/weak/ptrs
 
 
-/// Process the commands waiting in the queue. Only one command would be waiting at the moment
+/// Process the commands waiting in the queue, in the order they were issued
 void ExecuteCommands();
 
+///
+/// The commands issued between BeginCommandBatch and EndCommandBatch are executed as a single undo step.
+///
+void BeginCommandBatch();
+void EndCommandBatch();
+
+/// Number of commands in the undo stack and their estimated memory, in bytes
+size_t GetUndoStackSize();
+size_t GetUndoStackMemoryFootprint();
+
+/// Duration of the last undo or redo, in milliseconds
+double GetLastUndoRedoMilliseconds();
+
+/// Limit the memory of the undo stack, in bytes, 0 for no limit. The oldest commands are spilled to temporary
+/// crate files if spillToFile is true, and removed from the stack when it is not enough
+void SetUndoStackMemoryBudget(size_t memoryBudget, bool spillToFile);
+
 ///
 /// Allows to record one command spanning multiple frames.
 /// It is used in the manipulators, to record only one command for a translation/rotation etc.
@@ -248,3 +273,10 @@ void ExecuteCommands();
 void BeginEdition(UsdStageRefPtr);
 void BeginEdition(SdfLayerRefPtr);
 void EndEdition();
+bool IsEditionInProgress();
+
+///
+/// Background tasks reading the stages, like the prim search index, must not run while the layers are edited.
+/// The callbacks are called before the commands are executed and when an edition begins.
+///
+void AddBeforeEditionCallback(std::function<void()> callback);
@@ -23,10 +23,22 @@ bool SdfUndoRedoCommand::DoIt() {
 }
 namespace {
 SdfUndoRedoRecorder *undoRedoRecorder = nullptr;
+std::vector<std::function<void()>> beforeEditionCallbacks;
 }
 
+void AddBeforeEditionCallback(std::function<void()> callback) { beforeEditionCallbacks.emplace_back(std::move(callback)); }
+
+void CallBeforeEditionCallbacks() {
+    for (const auto &callback : beforeEditionCallbacks) {
+        callback();
+    }
+}
+
+bool IsEditionInProgress() { return undoRedoRecorder != nullptr; }
+
 void BeginEdition(SdfLayerRefPtr layer) {
     if (layer) {
+        CallBeforeEditionCallbacks();
         // TODO: check there is no undoRedoRecorder alive
         undoRedoRecorder = new SdfUndoRedoRecorder(layer);
         undoRedoRecorder->StartRecording();
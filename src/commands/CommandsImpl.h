@@ -10,12 +10,23 @@ struct Command {
     virtual ~Command(){};
     virtual bool DoIt() = 0;
     virtual bool UndoIt() { return false; }
+
+    /// Estimated memory used by the command in the undo stack, in bytes
+    virtual size_t GetMemoryFootprint() const { return sizeof(Command); }
+
+    /// Move the data kept for the undo to a temporary file, returns the number of bytes released
+    virtual size_t SpillToFile() { return 0; }
+
+    /// Returns false if the command doesn't edit the stages, the background tasks reading them are then kept running
+    virtual bool IsEdition() const { return true; }
 };
 
 struct SdfLayerCommand : public Command {
     virtual ~SdfLayerCommand(){};
     virtual bool DoIt() override = 0;
     bool UndoIt() override;
+    size_t GetMemoryFootprint() const override { return sizeof(SdfLayerCommand) + _undoCommands.GetMemoryFootprint(); }
+    size_t SpillToFile() override { return _undoCommands.SpillToFile(); }
     SdfCommandGroup _undoCommands;
 };
 
@@ -40,5 +51,10 @@ struct UsdFunctionCall : public Command {
     bool UndoIt() override { return false; }
 
     SdfLayerHandle _layer;
+    // When the function is called on a stage, the edits are recorded on all its layers
+    UsdStageRefPtr _stage;
     std::function<void()> _func;
 };
+
+// Stop the background tasks reading the stages before they are edited
+void CallBeforeEditionCallbacks();
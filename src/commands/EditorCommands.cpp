@@ -11,7 +11,7 @@
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdUtils/dependencies.h>
 #include <string>
-#include "WildcardsCompare.h"
+#include <algorithm>
 
 #include "SdfUndoRedoRecorder.h"
 ///
@@ -33,12 +33,13 @@ struct EditorSetDataPointer : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorSetDataPointer>(Editor *editor);
 
+/// Select a single path. The previous selection is restored when the command is undone, like the batch selection commands.
 struct EditorSetSelection : public EditorCommand {
     EditorSetSelection(UsdStageRefPtr stage, SdfPath path)
-    : _stageRefPtr(stage), _path(path) {}
+    : _stage(stage), _path(path) {}
     
     EditorSetSelection(const UsdStageWeakPtr & stage, SdfPath path)
-    : _stageRefPtr(stage), _path(path) {}
+    : _stage(stage), _path(path) {}
     
     EditorSetSelection(SdfLayerRefPtr layer, SdfPath path)
     : _layer(layer), _path(path) {}
@@ -51,28 +52,190 @@ struct EditorSetSelection : public EditorCommand {
     // TODO: wip, we want an "Selection" object to be passed around
     // At the moment it is just the pointer to the current selection held by the editor
     bool DoIt() override {
+        bool hasChanged = false;
         if(_editor) {
             auto & selection = _editor->GetSelection();
-            if (_layer) {
-                _editor->SetCurrentLayer(_layer);
+            const SdfLayerRefPtr layer = TfCreateRefPtrFromProtectedWeakPtr(_layer);
+            if (layer) {
+                _editor->SetCurrentLayer(layer);
+                _previousLayerPaths = selection.GetSelectedPaths(_layer);
                 _editor->SetLayerPathSelection(_path);
+                hasChanged = selection.GetSelectedPaths(_layer) != _previousLayerPaths;
             }
-            if (_stageRefPtr) {
-                _editor->SetCurrentStage(_stageRefPtr);
+            const UsdStageRefPtr stage = TfCreateRefPtrFromProtectedWeakPtr(_stage);
+            if (stage) {
+                _editor->SetCurrentStage(stage);
+                _previousStagePaths = selection.GetSelectedPaths(stage);
+                SelectionHash selectionHash = 0;
+                selection.UpdateSelectionHash(stage, selectionHash);
                 _editor->SetStagePathSelection(_path);
+                hasChanged = selection.UpdateSelectionHash(stage, selectionHash) || hasChanged;
             }
         }
-        return false;
+        // The command is only stored in the undo stack if it has modified the selection
+        return hasChanged;
     }
-    UsdStageRefPtr _stageRefPtr;
-    SdfLayerRefPtr _layer;
+
+    bool UndoIt() override {
+        if (!_editor)
+            return false;
+        auto &selection = _editor->GetSelection();
+        const SdfLayerRefPtr layer = TfCreateRefPtrFromProtectedWeakPtr(_layer);
+        if (layer) {
+            selection.Clear(layer);
+            for (const auto &path : _previousLayerPaths) {
+                selection.AddSelected(layer, path);
+            }
+        }
+        const UsdStageRefPtr stage = TfCreateRefPtrFromProtectedWeakPtr(_stage);
+        if (stage) {
+            selection.Clear(stage);
+            for (const auto &path : _previousStagePaths) {
+                selection.AddSelected(stage, path);
+            }
+        }
+        return true;
+    }
+
+    bool IsEdition() const override { return false; }
+
+    // The stage and the layer are held weakly, the commands in the undo stack don't keep them alive
+    UsdStageWeakPtr _stage;
+    SdfLayerHandle _layer;
     SdfPath _path;
+    SdfPathVector _previousStagePaths;
+    SdfPathVector _previousLayerPaths;
 };
 template void ExecuteAfterDraw<EditorSetSelection>(UsdStageWeakPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(UsdStageRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerHandle, SdfPath);
 
+/// Base class of the commands modifying the stage selection in one pass. The previous selection is kept to be restored
+/// when the command is undone, so a batch of paths is a single undo step.
+/// The stage is held weakly, the commands in the undo stack don't keep a closed stage alive.
+struct EditorStageSelectionCommand : public EditorCommand {
+    EditorStageSelectionCommand(UsdStageRefPtr stage) : _stage(stage) {}
+    ~EditorStageSelectionCommand() override {}
+
+    bool DoIt() override {
+        const UsdStageRefPtr stage = TfCreateRefPtrFromProtectedWeakPtr(_stage);
+        if (!_editor || !stage)
+            return false;
+        auto &selection = _editor->GetSelection();
+        _previousPaths = selection.GetSelectedPaths(stage);
+        SelectionHash selectionHash = 0;
+        selection.UpdateSelectionHash(stage, selectionHash);
+        Apply(selection, stage);
+        // The command is only stored in the undo stack if it has modified the selection
+        return selection.UpdateSelectionHash(stage, selectionHash);
+    }
+
+    bool UndoIt() override {
+        const UsdStageRefPtr stage = TfCreateRefPtrFromProtectedWeakPtr(_stage);
+        if (!_editor || !stage)
+            return false;
+        auto &selection = _editor->GetSelection();
+        selection.Clear(stage);
+        for (const auto &path : _previousPaths) {
+            selection.AddSelected(stage, path);
+        }
+        return true;
+    }
+
+    bool IsEdition() const override { return false; }
+
+    virtual void Apply(Selection &selection, const UsdStageRefPtr &stage) = 0;
+
+    UsdStageWeakPtr _stage;
+    SdfPathVector _previousPaths;
+};
+
+/// Replace the stage selection by the paths, the first one being the anchor
+struct EditorSelectPaths : public EditorStageSelectionCommand {
+    EditorSelectPaths(UsdStageRefPtr stage, SdfPathVector paths) : EditorStageSelectionCommand(stage), _paths(std::move(paths)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        selection.Clear(stage);
+        for (const auto &path : _paths) {
+            selection.AddSelected(stage, path);
+        }
+    }
+    SdfPathVector _paths;
+};
+template void ExecuteAfterDraw<EditorSelectPaths>(UsdStageRefPtr, SdfPathVector);
+
+/// Add the paths to the stage selection
+struct EditorAddSelectedPaths : public EditorStageSelectionCommand {
+    EditorAddSelectedPaths(UsdStageRefPtr stage, SdfPathVector paths)
+        : EditorStageSelectionCommand(stage), _paths(std::move(paths)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        for (const auto &path : _paths) {
+            selection.AddSelected(stage, path);
+        }
+    }
+    SdfPathVector _paths;
+};
+template void ExecuteAfterDraw<EditorAddSelectedPaths>(UsdStageRefPtr, SdfPathVector);
+
+/// Remove the paths from the stage selection
+struct EditorRemoveSelectedPaths : public EditorStageSelectionCommand {
+    EditorRemoveSelectedPaths(UsdStageRefPtr stage, SdfPathVector paths)
+        : EditorStageSelectionCommand(stage), _paths(std::move(paths)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        for (const auto &path : _paths) {
+            selection.RemoveSelected(stage, path);
+        }
+    }
+    SdfPathVector _paths;
+};
+template void ExecuteAfterDraw<EditorRemoveSelectedPaths>(UsdStageRefPtr, SdfPathVector);
+
+/// Select the unselected descendants of a prim and deselect the selected ones
+struct EditorInvertSelection : public EditorStageSelectionCommand {
+    EditorInvertSelection(UsdStageRefPtr stage, SdfPath root) : EditorStageSelectionCommand(stage), _root(std::move(root)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        const UsdPrim root = stage->GetPrimAtPath(_root);
+        if (!root)
+            return;
+        UsdPrimRange range(root, UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate));
+        // Skip the root, only its descendants are inverted
+        auto it = range.begin();
+        for (++it; it != range.end(); ++it) {
+            const SdfPath &path = it->GetPath();
+            if (selection.IsSelected(stage, path)) {
+                selection.RemoveSelected(stage, path);
+            } else {
+                selection.AddSelected(stage, path);
+            }
+        }
+    }
+    SdfPath _root;
+};
+template void ExecuteAfterDraw<EditorInvertSelection>(UsdStageRefPtr, SdfPath);
+
+/// Select a prim and all its descendants
+struct EditorAddSelectedSubtree : public EditorStageSelectionCommand {
+    EditorAddSelectedSubtree(UsdStageRefPtr stage, SdfPath root) : EditorStageSelectionCommand(stage), _root(std::move(root)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override { selection.AddSelectedSubtree(stage, _root); }
+    SdfPath _root;
+};
+template void ExecuteAfterDraw<EditorAddSelectedSubtree>(UsdStageRefPtr, SdfPath);
+
+/// Deselect a prim and all its selected descendants
+struct EditorRemoveSelectedSubtree : public EditorStageSelectionCommand {
+    EditorRemoveSelectedSubtree(UsdStageRefPtr stage, SdfPath root)
+        : EditorStageSelectionCommand(stage), _root(std::move(root)) {}
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override { selection.RemoveSelectedSubtree(stage, _root); }
+    SdfPath _root;
+};
+template void ExecuteAfterDraw<EditorRemoveSelectedSubtree>(UsdStageRefPtr, SdfPath);
+
 // TODO use setlayerlocation instead ???
 struct EditorSelectAttributePath : public EditorCommand {
 
@@ -327,54 +490,53 @@ struct EditorRemoveLauncher : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorRemoveLauncher>(const std::string);
 
-// This will try to find the next matching prim after the selection
-struct EditorFindPrim : public EditorCommand {
-    EditorFindPrim(const std::string pattern, bool useRegex) : _pattern(pattern) {
-        if (useRegex) {
-            _matches = [&](const std::string &str) { return FastWildComparePortable(_pattern.c_str(), str.c_str()); };
+/// Select the next or previous prim found by the search query of the editor
+struct EditorFindPrim : public EditorStageSelectionCommand {
+    EditorFindPrim(bool findPrevious)
+        : EditorStageSelectionCommand(_editor ? _editor->GetCurrentStage() : UsdStageRefPtr()), _findPrevious(findPrevious) {}
+    ~EditorFindPrim() override{};
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        SdfPathVector matches;
+        _editor->GetPrimQuery().FetchResults(matches);
+        if (matches.empty()) {
+            return;
+        }
+        // Look for the match following or preceding the anchor in the sorted matches
+        std::sort(matches.begin(), matches.end());
+        const auto anchor = selection.GetAnchorPrimPath(stage);
+        SdfPath found;
+        if (_findPrevious) {
+            const auto it = std::lower_bound(matches.begin(), matches.end(), anchor);
+            found = it == matches.begin() ? matches.back() : *std::prev(it);
         } else {
-            _matches = [&](const std::string &str) { return str == _pattern; };
+            const auto it = anchor == SdfPath() ? matches.begin() : std::upper_bound(matches.begin(), matches.end(), anchor);
+            found = it == matches.end() ? matches.front() : *it;
         }
+        selection.SetSelected(stage, found);
     }
-    ~EditorFindPrim() override{};
 
-    bool DoIt() override {
-        if (_editor) {
-            const auto &stage = _editor->GetCurrentStage();
-            auto &selection = _editor->GetSelection();
-            auto anchor = selection.GetAnchorPrimPath(stage);
-            SdfPath found;
-            bool selectedFound = false;
-            // Traverse the stage and set the new selection
-            auto range = UsdPrimRange::Stage(stage, UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate));
-            for (auto iter = range.begin(); iter != range.end(); ++iter) {
-                if (iter->GetPath() == anchor) {
-                    selectedFound = true;
-                } else if (_matches(iter->GetName())) {
-                    // Store the first matching path in case we don't find the one
-                    // after the anchor
-                    if (found == SdfPath()) {
-                        found = iter->GetPath();
-                        // We don't have an anchor, so the first match is the correct one
-                        if (anchor == SdfPath())
-                            break;
-                    }
-                    if (selectedFound) {
-                        found = iter->GetPath();
-                        break;
-                    }
-                }
-            }
-            if (found != SdfPath()) {
-                selection.SetSelected(stage, found);
+    bool _findPrevious;
+};
+template void ExecuteAfterDraw<EditorFindPrim>(bool findPrevious);
+
+/// Select all the prims found by the search query of the editor
+struct EditorSelectFoundPrims : public EditorStageSelectionCommand {
+    EditorSelectFoundPrims() : EditorStageSelectionCommand(_editor ? _editor->GetCurrentStage() : UsdStageRefPtr()) {}
+    ~EditorSelectFoundPrims() override{};
+
+    void Apply(Selection &selection, const UsdStageRefPtr &stage) override {
+        SdfPathVector matches;
+        _editor->GetPrimQuery().FetchResults(matches);
+        if (!matches.empty()) {
+            selection.Clear(stage);
+            for (const auto &path : matches) {
+                selection.AddSelected(stage, path);
             }
         }
-        return false;
     }
-    std::function<bool(const std::string &)> _matches;
-    std::string _pattern;
 };
-template void ExecuteAfterDraw<EditorFindPrim>(const std::string, bool useRegex);
+template void ExecuteAfterDraw<EditorSelectFoundPrims>();
 
 struct EditorExportUsdz : public EditorCommand {
     EditorExportUsdz(const std::string destination, bool useArKit) : _destination(destination), _useArKit(useArKit) {}
@@ -383,7 +545,7 @@ struct EditorExportUsdz : public EditorCommand {
         SdfCommandGroup _undoCommands;
         {
             SdfAssetPath stageAssetPath(_editor->GetCurrentStage()->GetRootLayer()->GetRealPath());
-            SdfCommandGroupRecorder recorder(_undoCommands, _editor->GetCurrentStage()->GetUsedLayers());
+            SdfCommandGroupRecorder recorder(_undoCommands, _editor->GetCurrentStage());
             if (_useArKit) {
                 UsdUtilsCreateNewARKitUsdzPackage(stageAssetPath, _destination);
             } else {
@@ -1,8 +1,11 @@
 
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/usd/sdf/copyUtils.h>
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/primSpec.h>
 #include <pxr/usd/sdf/reference.h>
 #include "CommandsImpl.h"
+#include "SdfLayerDiff.h"
 #include "SdfUndoRedoRecorder.h"
 #include <pxr/usd/sdf/variantSpec.h>
 
@@ -149,39 +152,67 @@ struct LayerUnmute : public Command {
 template void ExecuteAfterDraw<LayerUnmute>(SdfLayerRefPtr layer);
 template void ExecuteAfterDraw<LayerUnmute>(SdfLayerHandle layer);
 
-/* WARNING: this is a brute force and dumb implementation of storing text modification.
- It basically stores the previous and new layer as text in a string. So .... this will eat up the memory
- quite quickly if used intensively.
- But for now it's a quick way to test if text editing is worth in the application.
- */
+/// Replace the content of a layer by a text. The text is parsed in a scratch layer and only the differences with the
+/// layer are written, so the undo and redo are proportional to the changes instead of the layer size, and the texts
+/// are not kept.
 struct LayerTextEdit : public SdfLayerCommand {
 
-    LayerTextEdit(SdfLayerRefPtr layer, std::string newText) : _layer(layer), _newText(newText) {}
+    LayerTextEdit(SdfLayerRefPtr layer, std::string newText) : _layer(layer), _newText(std::move(newText)) {}
 
     ~LayerTextEdit() override {}
 
     bool DoIt() override {
         if (!_layer)
             return false;
-        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
-        if (_oldText.empty()) {
-            _layer->ExportToString(&_oldText);
+        // Redo
+        if (!_undoCommands.IsEmpty()) {
+            _undoCommands.DoIt();
+            return true;
         }
-        return _layer->ImportFromString(_newText);
-        //_layer->SetDirty();
+        SdfLayerRefPtr scratchLayer = SdfLayer::CreateAnonymous("text.usda");
+        if (!scratchLayer->ImportFromString(_newText))
+            return false;
+        _newText.clear();
+        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
+        ApplyLayerDifferences(scratchLayer, _layer);
+        return !_undoCommands.IsEmpty();
     };
 
-    bool UndoIt() override {
-        if (!_layer)
+    SdfLayerRefPtr _layer;
+    std::string _newText;
+};
+template void ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr layer, std::string newText);
+
+/// Replace a prim spec and its descendants by the prim parsed from a text. The text is a layer with a single root prim,
+/// it is parsed in a scratch layer and copied to the prim path, so the edit and its undo only touch the edited prim
+/// instead of reloading the whole layer.
+struct LayerPrimTextEdit : public SdfLayerCommand {
+
+    LayerPrimTextEdit(SdfLayerRefPtr layer, SdfPath primPath, std::string newText)
+        : _layer(layer), _primPath(primPath), _newText(std::move(newText)) {}
+
+    ~LayerPrimTextEdit() override {}
+
+    bool DoIt() override {
+        if (!_layer || !_primPath.IsPrimPath())
+            return false;
+        SdfLayerRefPtr scratchLayer = SdfLayer::CreateAnonymous("prim.usda");
+        if (!scratchLayer->ImportFromString(_newText))
             return false;
-        return _layer->ImportFromString(_oldText);
+        const auto rootPrims = scratchLayer->GetRootPrims();
+        if (rootPrims.size() != 1) {
+            TF_RUNTIME_ERROR("The text of %s must contain exactly one root prim", _primPath.GetText());
+            return false;
+        }
+        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
+        return SdfCopySpec(scratchLayer, rootPrims[0]->GetPath(), _layer, _primPath);
     }
 
     SdfLayerRefPtr _layer;
-    std::string _oldText;
+    SdfPath _primPath;
     std::string _newText;
 };
-template void ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr layer, std::string newText);
+template void ExecuteAfterDraw<LayerPrimTextEdit>(SdfLayerRefPtr layer, SdfPath primPath, std::string newText);
 
 struct LayerCreateOversFromPath : public SdfLayerCommand {
 
@@ -1,28 +1,226 @@
 #include <memory>
 #include <iostream>
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/attributeSpec.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/sdf/types.h>
 #include "SdfCommandGroup.h"
 #include "SdfLayerInstructions.h"
 
+// Location of the spilled values in the temporary layer
+static const SdfPath SpilledValuesPath("/SpilledValues");
+
+static inline TfToken GetSpilledValueName(size_t valueIndex) { return TfToken(TfStringPrintf("value%zu", valueIndex)); }
+
+SdfCommandGroup::~SdfCommandGroup() {
+    // The values read from the file must be released before deleting it
+    _instructions.clear();
+    if (!_spillFile.empty()) {
+        TfDeleteFile(_spillFile);
+    }
+}
+
 
 
 bool SdfCommandGroup::IsEmpty() const { return _instructions.empty(); }
 
-void SdfCommandGroup::Clear() { _instructions.clear(); }
+void SdfCommandGroup::Clear() {
+    _instructions.clear();
+    _lastInstructions.clear();
+    _memoryFootprint = 0;
+    _targets.clear();
+    _skippedOnUndo.clear();
+    _deletedAsSignificant.clear();
+    _isSpilled = false;
+    if (!_spillFile.empty()) {
+        TfDeleteFile(_spillFile);
+        _spillFile.clear();
+    }
+}
+
+// Only the arrays are spilled, they are the values taking memory and they are supported by the crate format
+size_t SdfCommandGroup::SpillToFile() {
+    if (_isSpilled)
+        return 0;
+    if (_spillFile.empty()) {
+        SdfLayerRefPtr layer = SdfLayer::CreateAnonymous("undo.usdc");
+        SdfPrimSpecHandle spilledValues = SdfPrimSpec::New(layer, SpilledValuesPath.GetName(), SdfSpecifierOver);
+        size_t valueIndex = 0;
+        std::vector<bool> isValueInFile;
+        bool hasSpilledValues = false;
+        for (auto &instruction : _instructions) {
+            instruction.ForEachValue([&](VtValue &value) {
+                const TfToken valueName = GetSpilledValueName(valueIndex);
+                isValueInFile.push_back(false);
+                if (value.IsArrayValued()) {
+                    SdfAttributeSpecHandle attribute =
+                        SdfAttributeSpec::New(spilledValues, valueName, SdfGetValueTypeNameForValue(value));
+                    if (attribute && attribute->SetDefaultValue(value)) {
+                        isValueInFile[valueIndex] = true;
+                        hasSpilledValues = true;
+                    }
+                }
+                valueIndex++;
+            });
+        }
+        if (!hasSpilledValues)
+            return 0;
+        const std::string spillFile = ArchMakeTmpFileName("usdtweak_undo", ".usdc");
+        if (!layer->Export(spillFile)) {
+            std::cerr << "ERROR: unable to write the undo values to " << spillFile << std::endl;
+            return 0;
+        }
+        _spillFile = spillFile;
+        _isValueInFile = std::move(isValueInFile);
+    }
+    // Release only the values written in the file, the others would be lost
+    const size_t previousFootprint = _memoryFootprint;
+    size_t valueIndex = 0;
+    for (auto &instruction : _instructions) {
+        instruction.ForEachValue([&](VtValue &value) {
+            if (valueIndex < _isValueInFile.size() && _isValueInFile[valueIndex]) {
+                _memoryFootprint -= GetValueFootprint(value);
+                value = VtValue();
+            }
+            valueIndex++;
+        });
+    }
+    _isSpilled = true;
+    return previousFootprint - _memoryFootprint;
+}
+
+void SdfCommandGroup::ReloadSpilledValues() {
+    if (!_isSpilled)
+        return;
+    SdfLayerRefPtr layer = SdfLayer::OpenAsAnonymous(_spillFile);
+    if (!layer) {
+        std::cerr << "ERROR: unable to read the undo values from " << _spillFile << std::endl;
+        return;
+    }
+    size_t valueIndex = 0;
+    for (auto &instruction : _instructions) {
+        instruction.ForEachValue([&](VtValue &value) {
+            const SdfPath valuePath = SpilledValuesPath.AppendProperty(GetSpilledValueName(valueIndex++));
+            if (value.IsEmpty() && layer->HasField(valuePath, SdfFieldKeys->Default)) {
+                value = layer->GetField(valuePath, SdfFieldKeys->Default);
+                _memoryFootprint += GetValueFootprint(value);
+            }
+        });
+    }
+    _isSpilled = false;
+}
+
+size_t SdfCommandGroup::FieldKeyHash::operator()(const FieldKey &key) const {
+    size_t hash = std::hash<const void *>()(key.layer);
+    hash = hash * 31 + key.path.GetHash();
+    hash = hash * 31 + key.fieldName.Hash();
+    hash = hash * 31 + key.keyPath.Hash();
+    return hash * 31 + std::hash<double>()(key.timeCode);
+}
+
+// A write on a field already written by the group updates the new value of the previous instruction, which keeps the
+// value to restore. The instructions are merged only if no other instruction edited the spec in between, so replaying
+// them in order gives the same result.
+template <typename InstructionT>
+bool SdfCommandGroup::MergeInstruction(InstructionT &inst, const FieldKey &key) {
+    const FieldKey specKey{key.layer, key.path, TfToken(), TfToken(), 0.0};
+    const auto lastOnField = _lastInstructions.find(key);
+    if (lastOnField != _lastInstructions.end()) {
+        const auto lastOnSpec = _lastInstructions.find(specKey);
+        if (lastOnSpec != _lastInstructions.end() && lastOnSpec->second == lastOnField->second) {
+            InstructionT &previous = _instructions[lastOnField->second].Get<InstructionT>();
+            _memoryFootprint += GetValueFootprint(inst._newValue);
+            _memoryFootprint -= GetValueFootprint(previous._newValue);
+            previous._newValue = std::move(inst._newValue);
+            return true;
+        }
+    }
+    _lastInstructions[key] = _instructions.size();
+    _lastInstructions[specKey] = _instructions.size();
+    return false;
+}
+
+// Spec edited by each instruction. The moves and deletions change the paths of the specs already recorded,
+// they are considered as removals.
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoSetField &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoSetFieldDictValueByKey &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoSetTimeSample &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoArrayEdit &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoCreateSpec &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::SpecCreation};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoDeleteSpec &inst) {
+    return {get_pointer(inst._layer), inst._path, SdfCommandGroup::InstructionTarget::SpecRemoval};
+}
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoMoveSpec &inst) {
+    return {get_pointer(inst._layer), inst._oldPath, SdfCommandGroup::InstructionTarget::SpecRemoval};
+}
+template <typename ValueT>
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoPushChild<ValueT> &inst) {
+    return {get_pointer(inst._layer), inst._parentPath, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
+template <typename ValueT>
+static inline SdfCommandGroup::InstructionTarget GetInstructionTarget(const UndoRedoPopChild<ValueT> &inst) {
+    return {get_pointer(inst._layer), inst._parentPath, SdfCommandGroup::InstructionTarget::FieldEdit};
+}
 
 template <typename InstructionT>
 void SdfCommandGroup::StoreInstruction(InstructionT inst) {
-    // TODO: specialize by InstructionT type to compact the instructions in the command,
-    // typically we don't want to store thousand of setField instruction where only the last one matters
-    // One optim would be to look for the previous instruction, check if it is a setfield on the same path, same layer ?
-    // Update the latest instruction instead of inserting a new instruction
-    // As StoreInstruction is templatized, it is possible to specialize it.
+    // The structural changes can modify any spec, the following writes are not merged with the previous ones
+    _lastInstructions.clear();
+    _targets.push_back(GetInstructionTarget(inst));
+    _skippedOnUndo.clear();
+    _memoryFootprint += sizeof(InstructionWrapper::Storage<InstructionT>) + inst.GetDataFootprint();
     _instructions.emplace_back(std::move(inst));
 }
 
+// Typically a manipulator or a slider writes the same field thousand of times, only the first previous value and the last
+// new value are kept
+template <>
+void SdfCommandGroup::StoreInstruction<UndoRedoSetField>(UndoRedoSetField inst) {
+    const FieldKey key{get_pointer(inst._layer), inst._path, inst._fieldName, TfToken(), 0.0};
+    if (!MergeInstruction(inst, key)) {
+        _memoryFootprint += sizeof(InstructionWrapper::Storage<UndoRedoSetField>) + inst.GetDataFootprint();
+        _targets.push_back(GetInstructionTarget(inst));
+        _skippedOnUndo.clear();
+        _instructions.emplace_back(std::move(inst));
+    }
+}
+
+template <>
+void SdfCommandGroup::StoreInstruction<UndoRedoSetFieldDictValueByKey>(UndoRedoSetFieldDictValueByKey inst) {
+    const FieldKey key{get_pointer(inst._layer), inst._path, inst._fieldName, inst._keyPath, 0.0};
+    if (!MergeInstruction(inst, key)) {
+        _memoryFootprint += sizeof(InstructionWrapper::Storage<UndoRedoSetFieldDictValueByKey>) + inst.GetDataFootprint();
+        _targets.push_back(GetInstructionTarget(inst));
+        _skippedOnUndo.clear();
+        _instructions.emplace_back(std::move(inst));
+    }
+}
+
+template <>
+void SdfCommandGroup::StoreInstruction<UndoRedoSetTimeSample>(UndoRedoSetTimeSample inst) {
+    const FieldKey key{get_pointer(inst._layer), inst._path, SdfFieldKeys->TimeSamples, TfToken(), inst._timeCode};
+    if (!MergeInstruction(inst, key)) {
+        _memoryFootprint += sizeof(InstructionWrapper::Storage<UndoRedoSetTimeSample>) + inst.GetDataFootprint();
+        _targets.push_back(GetInstructionTarget(inst));
+        _skippedOnUndo.clear();
+        _instructions.emplace_back(std::move(inst));
+    }
+}
 
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetField>(UndoRedoSetField inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetFieldDictValueByKey>(UndoRedoSetFieldDictValueByKey inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetTimeSample>(UndoRedoSetTimeSample inst);
+
+template void SdfCommandGroup::StoreInstruction<UndoRedoArrayEdit>(UndoRedoArrayEdit inst);
 template void SdfCommandGroup::StoreInstruction<UndoRedoCreateSpec>(UndoRedoCreateSpec inst);
 template void SdfCommandGroup::StoreInstruction<UndoRedoDeleteSpec>(UndoRedoDeleteSpec inst);
 template void SdfCommandGroup::StoreInstruction<UndoRedoMoveSpec>(UndoRedoMoveSpec inst);
@@ -31,15 +229,64 @@ template void SdfCommandGroup::StoreInstruction<UndoRedoPushChild<SdfPath>>(Undo
 template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<TfToken>>(UndoRedoPopChild<TfToken> inst);
 template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<SdfPath>>(UndoRedoPopChild<SdfPath> inst);
 
+// An instruction following the creation of its spec, or of an ancestor, doesn't need to be undone: undoing the
+// creation deletes the spec with its fields and descendants. Undoing a paste or a text edit of a large hierarchy then
+// only deletes the root specs. The paths of the created specs are not stable across a move or a deletion, so only the
+// creations following the last move or deletion are considered. The other instructions are still undone one by one
+// through the layer state delegate.
+// A spec created inert, like an over, can be made significant by a skipped instruction setting its specifier or type. The
+// root spec is then deleted as a significant spec, so the stage is resynced.
+void SdfCommandGroup::ComputeSkippedOnUndo() {
+    _skippedOnUndo.assign(_targets.size(), false);
+    _deletedAsSignificant.assign(_targets.size(), false);
+    std::unordered_map<const void *, std::unordered_map<SdfPath, size_t, SdfPath::Hash>> createdSpecs;
+    for (size_t i = 0; i < _targets.size(); ++i) {
+        const InstructionTarget &target = _targets[i];
+        if (target.kind == InstructionTarget::SpecRemoval) {
+            createdSpecs.clear();
+            continue;
+        }
+        const auto layerSpecs = createdSpecs.find(target.layer);
+        if (layerSpecs != createdSpecs.end()) {
+            // The deleted spec is the outermost created ancestor
+            size_t rootCreation = _targets.size();
+            for (SdfPath path = target.path; !path.IsEmpty(); path = path.GetParentPath()) {
+                const auto created = layerSpecs->second.find(path);
+                if (created != layerSpecs->second.end()) {
+                    rootCreation = created->second;
+                }
+            }
+            if (rootCreation < _targets.size()) {
+                _skippedOnUndo[i] = true;
+                _deletedAsSignificant[rootCreation] = true;
+            }
+        }
+        if (target.kind == InstructionTarget::SpecCreation) {
+            createdSpecs[target.layer].emplace(target.path, i);
+        }
+    }
+}
+
 // Call all the functions stored in _commands in reverse order
-void SdfCommandGroup::UndoIt() {
+void SdfCommandGroup::UndoIt(bool skipCreatedSpecs) {
+    ReloadSpilledValues();
+    if (skipCreatedSpecs && _skippedOnUndo.size() != _instructions.size()) {
+        ComputeSkippedOnUndo();
+    }
     SdfChangeBlock block;
-    for (auto cmd = _instructions.rbegin(); cmd != _instructions.rend(); ++cmd) {
-        cmd->UndoIt();
+    for (size_t i = _instructions.size(); i-- > 0;) {
+        if (!skipCreatedSpecs) {
+            _instructions[i].UndoIt();
+        } else if (_deletedAsSignificant[i]) {
+            _instructions[i].Get<UndoRedoCreateSpec>().UndoIt(false);
+        } else if (!_skippedOnUndo[i]) {
+            _instructions[i].UndoIt();
+        }
     }
 }
 
 void SdfCommandGroup::DoIt() {
+    ReloadSpilledValues();
     SdfChangeBlock block;
     for (auto &cmd : _instructions) {
         cmd.DoIt();
@@ -3,6 +3,13 @@
 #include <functional>
 #include <memory>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/usd/sdf/path.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
 
 
 class InstructionWrapper {
@@ -26,11 +33,22 @@ public:
         _ref->ShowIt();
     }
 
+    void ForEachValue(const std::function<void(VtValue &)> &func) {
+        _ref->ForEachValue(func);
+    }
+
+    /// Access to the stored instruction, InstructionT must be the type it was constructed with
+    template <typename InstructionT>
+    InstructionT &Get() {
+        return static_cast<Storage<InstructionT> *>(_ref.get())->_data;
+    }
+
     struct Interface {
         virtual ~Interface() = default;
         virtual void DoIt() = 0;
         virtual void UndoIt() = 0;
         virtual void ShowIt() = 0;
+        virtual void ForEachValue(const std::function<void(VtValue &)> &) = 0;
     };
 
     template <typename InstructionT>
@@ -47,6 +65,10 @@ public:
 
         void ShowIt() override { }
 
+        void ForEachValue(const std::function<void(VtValue &)> &func) override {
+            _data.ForEachValue(func);
+        }
+
         InstructionT _data;
     };
 
@@ -57,7 +79,7 @@ class SdfCommandGroup {
 
 public:
     SdfCommandGroup() = default;
-    ~SdfCommandGroup() = default;
+    ~SdfCommandGroup();
 
     /// Was it recorded
     bool IsEmpty() const;
@@ -65,13 +87,80 @@ public:
 
     /// Run the commands as an undo
     void DoIt();
-    void UndoIt();
+
+    /// Undo the instructions in reverse order. With skipCreatedSpecs, the instructions editing the specs created by the
+    /// group are not undone, deleting the created specs removes their fields and children anyway.
+    void UndoIt(bool skipCreatedSpecs = true);
+
+    /// Number of instructions recorded
+    size_t GetInstructionCount() const { return _instructions.size(); }
 
     template <typename InstructionT>
     void StoreInstruction(InstructionT);
 
+    /// Estimated memory used by the instructions, in bytes
+    size_t GetMemoryFootprint() const { return _memoryFootprint; }
+
+    /// Move the array values kept by the instructions to a temporary crate file, they are read back the next time
+    /// the group is executed. Returns the number of bytes released.
+    size_t SpillToFile();
+
+    /// Spec edited by an instruction, used to find the instructions that don't need to be undone
+    struct InstructionTarget {
+        enum Kind { FieldEdit, SpecCreation, SpecRemoval };
+        const void *layer;
+        SdfPath path;
+        Kind kind;
+    };
+
 private:
+    // Field, dictionary key or time sample written by an instruction. The keys with an empty
+    // field name identify the spec itself
+    struct FieldKey {
+        const void *layer;
+        SdfPath path;
+        TfToken fieldName;
+        TfToken keyPath;
+        double timeCode;
+        bool operator==(const FieldKey &other) const {
+            return layer == other.layer && path == other.path && fieldName == other.fieldName && keyPath == other.keyPath &&
+                   timeCode == other.timeCode;
+        }
+    };
+    struct FieldKeyHash {
+        size_t operator()(const FieldKey &key) const;
+    };
+
+    template <typename InstructionT>
+    bool MergeInstruction(InstructionT &inst, const FieldKey &key);
+
+    void ReloadSpilledValues();
+    void ComputeSkippedOnUndo();
+
     std::vector<InstructionWrapper> _instructions;
+
+    // Index of the last instruction writing a field, and of the last instruction editing a spec
+    std::unordered_map<FieldKey, size_t, FieldKeyHash> _lastInstructions;
+
+    size_t _memoryFootprint = 0;
+
+    // One target per instruction, and the instructions skipped by UndoIt, computed at the first undo
+    std::vector<InstructionTarget> _targets;
+    std::vector<bool> _skippedOnUndo;
+    std::vector<bool> _deletedAsSignificant; // Spec creations whose skipped instructions could have made the spec significant
+
+    // The temporary file is kept until the group is destroyed, the values are spilled only once
+    std::string _spillFile;
+    std::vector<bool> _isValueInFile; // Per value index, the values which couldn't be written stay in memory
+    bool _isSpilled = false;
 };
 
+// The field writes are merged by specializations
+struct UndoRedoSetField;
+struct UndoRedoSetFieldDictValueByKey;
+struct UndoRedoSetTimeSample;
+template <> void SdfCommandGroup::StoreInstruction<UndoRedoSetField>(UndoRedoSetField);
+template <> void SdfCommandGroup::StoreInstruction<UndoRedoSetFieldDictValueByKey>(UndoRedoSetFieldDictValueByKey);
+template <> void SdfCommandGroup::StoreInstruction<UndoRedoSetTimeSample>(UndoRedoSetTimeSample);
+
 
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <pxr/usd/usd/stage.h>
 #include "SdfCommandGroupRecorder.h"
 #include "UndoLayerStateDelegate.h"
 
@@ -12,6 +13,24 @@ SdfCommandGroupRecorder::SdfCommandGroupRecorder(SdfCommandGroup &undoCommands,
     SetUndoStateDelegates();
 }
 
+// The layers are collected when the recording starts, the delegates only record something on the layers written
+static SdfLayerHandleVector GetEditableLayers(const UsdStageRefPtr &stage) {
+    SdfLayerHandleVector layers;
+    if (stage) {
+        for (const auto &layer : stage->GetUsedLayers()) {
+            if (layer && layer->PermissionToEdit()) {
+                layers.push_back(layer);
+            }
+        }
+    }
+    return layers;
+}
+
+SdfCommandGroupRecorder::SdfCommandGroupRecorder(SdfCommandGroup &undoCommands, UsdStageRefPtr stage)
+: _undoCommands(undoCommands), _layers(GetEditableLayers(stage)) {
+    SetUndoStateDelegates();
+}
+
 SdfCommandGroupRecorder::~SdfCommandGroupRecorder() {
     UnsetUndoStateDelegates();
 }
@@ -19,11 +38,11 @@ SdfCommandGroupRecorder::~SdfCommandGroupRecorder() {
 
 void SdfCommandGroupRecorder::SetUndoStateDelegates() {
     if (_undoCommands.IsEmpty()) {
-        auto stateDelegate = UndoRedoLayerStateDelegate::New(_undoCommands);
+        // Each layer has its own delegate, as the delegate records the instructions on the layer it is attached to
         for (const auto &layer : _layers) {
             if (layer) {
                 _previousDelegates.push_back(layer->GetStateDelegate());
-                layer->SetStateDelegate(stateDelegate);
+                layer->SetStateDelegate(UndoRedoLayerStateDelegate::New(_undoCommands));
             } else {
                 _previousDelegates.push_back({});
             }
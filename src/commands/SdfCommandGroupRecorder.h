@@ -2,6 +2,7 @@
 
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/abstractData.h>
+#include <pxr/usd/usd/common.h>
 #include "SdfCommandGroup.h"
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -16,6 +17,10 @@ public:
     /// RAII object for recording Sdf "instructions" on one or multiple layers
     SdfCommandGroupRecorder(SdfCommandGroup &undoCommands, SdfLayerRefPtr layer);
     SdfCommandGroupRecorder(SdfCommandGroup &undoCommands, SdfLayerHandleVector layers);
+
+    /// Record the edits made on all the layers used by the stage, not only its edit target.
+    /// The layers that can't be edited are ignored.
+    SdfCommandGroupRecorder(SdfCommandGroup &undoCommands, UsdStageRefPtr stage);
     ~SdfCommandGroupRecorder();
 
 private:
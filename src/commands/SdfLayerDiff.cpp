@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <unordered_set>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/copyUtils.h>
+#include <pxr/usd/sdf/layerStateDelegate.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/sdf/propertySpec.h>
+#include <pxr/usd/sdf/schema.h>
+#include "SdfLayerDiff.h"
+
+namespace {
+
+// The prims are compared field by field and recursively, the properties and variant sets are compared as a whole
+// and copied when they differ
+enum class ChildrenKind { Prim, Property, VariantSet };
+
+const TfToken &GetChildrenField(ChildrenKind kind) {
+    switch (kind) {
+    case ChildrenKind::Property:
+        return SdfChildrenKeys->PropertyChildren;
+    case ChildrenKind::VariantSet:
+        return SdfChildrenKeys->VariantSetChildren;
+    default:
+        return SdfChildrenKeys->PrimChildren;
+    }
+}
+
+SdfPath GetChildPath(const SdfPath &parentPath, ChildrenKind kind, const TfToken &name) {
+    switch (kind) {
+    case ChildrenKind::Property:
+        return parentPath.AppendProperty(name);
+    case ChildrenKind::VariantSet:
+        return parentPath.AppendVariantSelection(name.GetString(), "");
+    default:
+        return parentPath.AppendChild(name);
+    }
+}
+
+// The children fields are compared with the children specs, not as values
+bool IsChildrenField(const TfToken &field) { return SdfSchema::GetInstance().HoldsChildren(field); }
+
+// Set the fields which differ and erase the fields missing in the source spec
+void ApplyFieldDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer, const SdfPath &path) {
+    for (const TfToken &field : dstLayer->ListFields(path)) {
+        if (!IsChildrenField(field) && !srcLayer->HasField(path, field)) {
+            dstLayer->EraseField(path, field);
+        }
+    }
+    for (const TfToken &field : srcLayer->ListFields(path)) {
+        if (!IsChildrenField(field)) {
+            const VtValue value = srcLayer->GetField(path, field);
+            if (dstLayer->GetField(path, field) != value) {
+                dstLayer->SetField(path, field, value);
+            }
+        }
+    }
+}
+
+SdfPathVector GetSubtreePaths(const SdfLayerHandle &layer, const SdfPath &path) {
+    SdfPathVector paths;
+    layer->Traverse(path, [&paths](const SdfPath &subtreePath) { paths.push_back(subtreePath); });
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool AreSubtreesEqual(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer, const SdfPath &path) {
+    const SdfPathVector paths = GetSubtreePaths(srcLayer, path);
+    if (paths != GetSubtreePaths(dstLayer, path))
+        return false;
+    for (const SdfPath &subtreePath : paths) {
+        if (srcLayer->GetSpecType(subtreePath) != dstLayer->GetSpecType(subtreePath))
+            return false;
+        std::vector<TfToken> fields = srcLayer->ListFields(subtreePath);
+        std::vector<TfToken> dstFields = dstLayer->ListFields(subtreePath);
+        std::sort(fields.begin(), fields.end());
+        std::sort(dstFields.begin(), dstFields.end());
+        if (fields != dstFields)
+            return false;
+        for (const TfToken &field : fields) {
+            if (srcLayer->GetField(subtreePath, field) != dstLayer->GetField(subtreePath, field))
+                return false;
+        }
+    }
+    return true;
+}
+
+void RemoveChild(const SdfLayerHandle &dstLayer, const SdfPath &parentPath, ChildrenKind kind, const TfToken &name) {
+    const SdfPath childPath = GetChildPath(parentPath, kind, name);
+    if (kind == ChildrenKind::Prim && parentPath.IsAbsoluteRootPath()) {
+        dstLayer->RemoveRootPrim(dstLayer->GetPrimAtPath(childPath));
+    } else if (SdfPrimSpecHandle parent = dstLayer->GetPrimAtPath(parentPath)) {
+        if (kind == ChildrenKind::Prim) {
+            parent->RemoveNameChild(dstLayer->GetPrimAtPath(childPath));
+        } else if (kind == ChildrenKind::Property) {
+            parent->RemoveProperty(dstLayer->GetPropertyAtPath(childPath));
+        } else {
+            parent->RemoveVariantSet(name.GetString());
+        }
+    }
+}
+
+void ApplyPrimDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer, const SdfPath &primPath);
+
+using TokenSet = std::unordered_set<TfToken, TfToken::HashFunctor>;
+
+// Remove the children missing in the source, copy the new ones and update the others. The removed children keep the
+// order of the others and the new ones are appended, the children field is then written only if the resulting order
+// differs from the source.
+void ApplyChildrenDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer, const SdfPath &parentPath,
+                              ChildrenKind kind) {
+    const TfToken &childrenField = GetChildrenField(kind);
+    const TfTokenVector srcNames = srcLayer->GetFieldAs<TfTokenVector>(parentPath, childrenField);
+    const TfTokenVector dstNames = dstLayer->GetFieldAs<TfTokenVector>(parentPath, childrenField);
+    // A parent can have hundred of thousands of children, they are looked up in sets
+    const TokenSet srcNameSet(srcNames.begin(), srcNames.end());
+    const TokenSet dstNameSet(dstNames.begin(), dstNames.end());
+    for (const TfToken &name : dstNames) {
+        if (srcNameSet.count(name) == 0) {
+            RemoveChild(dstLayer, parentPath, kind, name);
+        }
+    }
+    for (const TfToken &name : srcNames) {
+        const SdfPath childPath = GetChildPath(parentPath, kind, name);
+        if (dstNameSet.count(name) == 0) {
+            SdfCopySpec(srcLayer, childPath, dstLayer, childPath);
+        } else if (kind == ChildrenKind::Prim) {
+            ApplyPrimDifferences(srcLayer, dstLayer, childPath);
+        } else if (!AreSubtreesEqual(srcLayer, dstLayer, childPath)) {
+            // An attribute can be replaced by a relationship of the same name
+            if (srcLayer->GetSpecType(childPath) != dstLayer->GetSpecType(childPath)) {
+                RemoveChild(dstLayer, parentPath, kind, name);
+            }
+            SdfCopySpec(srcLayer, childPath, dstLayer, childPath);
+        }
+    }
+    if (dstLayer->GetFieldAs<TfTokenVector>(parentPath, childrenField) != srcNames) {
+        dstLayer->GetStateDelegate()->SetField(parentPath, childrenField, VtValue(srcNames));
+    }
+}
+
+void ApplyPrimDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer, const SdfPath &primPath) {
+    ApplyFieldDifferences(srcLayer, dstLayer, primPath);
+    ApplyChildrenDifferences(srcLayer, dstLayer, primPath, ChildrenKind::Property);
+    ApplyChildrenDifferences(srcLayer, dstLayer, primPath, ChildrenKind::VariantSet);
+    ApplyChildrenDifferences(srcLayer, dstLayer, primPath, ChildrenKind::Prim);
+}
+
+} // namespace
+
+void ApplyLayerDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer) {
+    if (!srcLayer || !dstLayer)
+        return;
+    SdfChangeBlock block;
+    const SdfPath &rootPath = SdfPath::AbsoluteRootPath();
+    ApplyFieldDifferences(srcLayer, dstLayer, rootPath);
+    ApplyChildrenDifferences(srcLayer, dstLayer, rootPath, ChildrenKind::Prim);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <pxr/usd/sdf/layer.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Modify dstLayer to make its content identical to srcLayer, only the fields and specs which differ are written.
+/// When the modification is recorded, its undo is proportional to the differences instead of the layer size.
+///
+void ApplyLayerDifferences(const SdfLayerHandle &srcLayer, const SdfLayerHandle &dstLayer);
@@ -1,8 +1,60 @@
 #include <iostream>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/quatf.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/vt/dictionary.h>
 #include <pxr/usd/sdf/path.h>
 #include <pxr/usd/sdf/abstractData.h>
+#include <pxr/usd/sdf/types.h>
 #include "SdfLayerInstructions.h"
 
+template <typename ElementT> static bool GetArrayFootprint(const VtValue &value, size_t &footprint) {
+    if (value.IsHolding<VtArray<ElementT>>()) {
+        footprint = value.UncheckedGet<VtArray<ElementT>>().size() * sizeof(ElementT);
+        return true;
+    }
+    return false;
+}
+
+size_t GetValueFootprint(const VtValue &value) {
+    size_t footprint = 0;
+    if (value.IsArrayValued()) {
+        // The most common array types, the others are counted as arrays of GfVec3f
+        if (!GetArrayFootprint<float>(value, footprint) && !GetArrayFootprint<double>(value, footprint) &&
+            !GetArrayFootprint<int>(value, footprint) && !GetArrayFootprint<GfVec2f>(value, footprint) &&
+            !GetArrayFootprint<GfVec3f>(value, footprint) && !GetArrayFootprint<GfVec3d>(value, footprint) &&
+            !GetArrayFootprint<GfQuatf>(value, footprint) && !GetArrayFootprint<GfMatrix4d>(value, footprint) &&
+            !GetArrayFootprint<TfToken>(value, footprint)) {
+            footprint = value.GetArraySize() * sizeof(GfVec3f);
+        }
+    } else if (value.IsHolding<std::string>()) {
+        footprint = value.UncheckedGet<std::string>().capacity();
+    } else if (value.IsHolding<VtDictionary>()) {
+        for (const auto &item : value.UncheckedGet<VtDictionary>()) {
+            footprint += item.first.capacity() + sizeof(VtValue) + GetValueFootprint(item.second);
+        }
+    } else if (value.IsHolding<SdfTimeSampleMap>()) {
+        for (const auto &sample : value.UncheckedGet<SdfTimeSampleMap>()) {
+            footprint += sizeof(sample) + GetValueFootprint(sample.second);
+        }
+    }
+    return footprint;
+}
+
+// Sums the footprint of the fields of the visited specs
+struct _SpecFootprint : public SdfAbstractDataSpecVisitor {
+    bool VisitSpec(const SdfAbstractData &data, const SdfPath &path) override {
+        for (const TfToken &field : data.List(path)) {
+            footprint += sizeof(VtValue) + GetValueFootprint(data.Get(path, field));
+        }
+        return true;
+    }
+    void Done(const SdfAbstractData &) override {}
+    size_t footprint = 0;
+};
+
 static void _CopySpec(const SdfAbstractData &src, SdfAbstractData *dst, const SdfPath &path) {
     if (!dst) {
         std::cerr << "ERROR: when copying the destination prim is null at path " << path.GetString() << std::endl;
@@ -31,9 +83,35 @@ UndoRedoDeleteSpec::UndoRedoDeleteSpec(SdfLayerHandle layer, const SdfPath &path
     SdfLayer::TraversalFunction copyFunc = std::bind(&_CopySpec, std::cref(*get_pointer(_layerData)),
                                                      get_pointer(_deletedData), std::placeholders::_1);
     _layer->Traverse(path, copyFunc);
+    _SpecFootprint specFootprint;
+    _deletedData->VisitSpecs(&specFootprint);
+    _deletedDataFootprint = specFootprint.footprint;
 }
 
 
+bool UndoRedoArrayEdit::Apply(const ArrayEdit &edit, ArrayEdit &inverse) {
+    if (!_layer || !_layer->GetStateDelegate())
+        return false;
+    SdfChangeBlock changeBlock;
+    VtValue value;
+    // The value is removed from the layer before the edit, so its array is not shared and is edited in place
+    if (_isDefault) {
+        value = _layer->GetField(_path, SdfFieldKeys->Default);
+        _layer->EraseField(_path, SdfFieldKeys->Default);
+    } else if (_layer->QueryTimeSample(_path, _timeCode, &value)) {
+        _layer->EraseTimeSample(_path, _timeCode);
+    }
+    if (value.IsEmpty())
+        return false;
+    const bool applied = edit.Apply(value, inverse);
+    if (_isDefault) {
+        _layer->GetStateDelegate()->SetField(_path, SdfFieldKeys->Default, value);
+    } else {
+        _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, value);
+    }
+    return applied;
+}
+
 void UndoRedoDeleteSpec::DoIt() {
     if (_layer && _layer->GetStateDelegate()) {
         _layer->GetStateDelegate()->DeleteSpec(_path, _inert);
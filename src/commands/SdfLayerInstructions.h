@@ -4,9 +4,16 @@
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/path.h>
 #include <pxr/usd/sdf/layerStateDelegate.h>
+#include "ArrayEdit.h"
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+/// Estimated memory used by the data of a value, in bytes
+size_t GetValueFootprint(const VtValue &value);
+
+// The instructions return the memory they use in addition to their size with GetDataFootprint, and give access to
+// the values they keep with ForEachValue
+
 struct UndoRedoSetField {
     UndoRedoSetField(SdfLayerHandle layer, const SdfPath& path, const TfToken& fieldName, VtValue newValue, VtValue previousValue )
         : _layer(layer), _path(path), _fieldName(fieldName), _newValue(std::move(newValue)), _previousValue(std::move(previousValue)) {}
@@ -26,6 +33,12 @@ struct UndoRedoSetField {
         }
     }
 
+    size_t GetDataFootprint() const { return GetValueFootprint(_newValue) + GetValueFootprint(_previousValue); }
+    template <typename FuncT> void ForEachValue(FuncT &&func) {
+        func(_newValue);
+        func(_previousValue);
+    }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const TfToken _fieldName;
@@ -53,6 +66,12 @@ struct UndoRedoSetFieldDictValueByKey {
         }
     }
 
+    size_t GetDataFootprint() const { return GetValueFootprint(_newValue) + GetValueFootprint(_previousValue); }
+    template <typename FuncT> void ForEachValue(FuncT &&func) {
+        func(_newValue);
+        func(_previousValue);
+    }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const TfToken _fieldName;
@@ -95,6 +114,12 @@ struct UndoRedoSetTimeSample {
         }
     }
 
+    size_t GetDataFootprint() const { return GetValueFootprint(_newValue) + GetValueFootprint(_previousValue); }
+    template <typename FuncT> void ForEachValue(FuncT &&func) {
+        func(_newValue);
+        func(_previousValue);
+    }
+
     // TODO: look for reducing the size of this struct
     SdfLayerRefPtr _layer;
     const SdfPath _path;
@@ -106,6 +131,39 @@ struct UndoRedoSetTimeSample {
 };
 
 
+// Sparse edit of the array held by the default value or a time sample of an attribute. Only the edited elements are
+// kept for the undo, instead of the full previous and new arrays
+struct UndoRedoArrayEdit {
+    UndoRedoArrayEdit(SdfLayerHandle layer, const SdfPath &path, bool isDefault, double timeCode, ArrayEdit edit)
+        : _layer(layer), _path(path), _isDefault(isDefault), _timeCode(timeCode), _edit(std::move(edit)) {}
+
+    UndoRedoArrayEdit(UndoRedoArrayEdit &&) = default;
+    ~UndoRedoArrayEdit() = default;
+
+    // Returns false if the edit could not be applied
+    bool DoIt() { return Apply(_edit, _inverse); }
+    void UndoIt() {
+        ArrayEdit edit;
+        Apply(_inverse, edit);
+    }
+
+    size_t GetDataFootprint() const { return GetValueFootprint(_edit.element) + GetValueFootprint(_inverse.element); }
+    template <typename FuncT> void ForEachValue(FuncT &&func) {
+        func(_edit.element);
+        func(_inverse.element);
+    }
+
+    bool Apply(const ArrayEdit &edit, ArrayEdit &inverse);
+
+    SdfLayerRefPtr _layer;
+    const SdfPath _path;
+    const bool _isDefault;
+    const double _timeCode;
+    ArrayEdit _edit;
+    ArrayEdit _inverse;
+};
+
+
 struct UndoRedoCreateSpec {
     UndoRedoCreateSpec(SdfLayerHandle layer, const SdfPath& path, SdfSpecType specType, bool inert)
         : _layer(layer), _path(path), _specType(specType), _inert(inert) {}
@@ -116,12 +174,18 @@ struct UndoRedoCreateSpec {
         }
     }
 
-    void UndoIt() {
+    void UndoIt() { UndoIt(_inert); }
+
+    // The spec is deleted as a significant spec when the instructions which could have changed its inertness are not undone
+    void UndoIt(bool inert) {
         if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->DeleteSpec(_path, _inert);
+            _layer->GetStateDelegate()->DeleteSpec(_path, _inert && inert);
         }
     }
 
+    size_t GetDataFootprint() const { return 0; }
+    template <typename FuncT> void ForEachValue(FuncT &&) {}
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const SdfSpecType _specType;
@@ -146,6 +210,9 @@ struct UndoRedoDeleteSpec {
     void DoIt();
     void UndoIt();
 
+    size_t GetDataFootprint() const { return _deletedDataFootprint; }
+    template <typename FuncT> void ForEachValue(FuncT &&) {}
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const bool _inert;
@@ -153,6 +220,7 @@ struct UndoRedoDeleteSpec {
     SdfAbstractDataPtr _layerData; // TODO: this might change ? isn't it ? normally it's retrieved from the delegate
     const SdfSpecType _deletedSpecType;
     SdfDataRefPtr _deletedData;
+    size_t _deletedDataFootprint = 0;
 };
 
 
@@ -174,6 +242,9 @@ struct UndoRedoMoveSpec {
         }
     };
 
+    size_t GetDataFootprint() const { return 0; }
+    template <typename FuncT> void ForEachValue(FuncT &&) {}
+
     SdfLayerRefPtr _layer;
     const SdfPath _oldPath;
     const SdfPath _newPath;
@@ -197,6 +268,9 @@ struct UndoRedoPushChild {
         }
     }
 
+    size_t GetDataFootprint() const { return 0; }
+    template <typename FuncT> void ForEachValue(FuncT &&) {}
+
     SdfLayerRefPtr _layer;
     const SdfPath _parentPath;
     const TfToken _fieldName;
@@ -221,6 +295,9 @@ struct UndoRedoPopChild {
         }
     }
 
+    size_t GetDataFootprint() const { return 0; }
+    template <typename FuncT> void ForEachValue(FuncT &&) {}
+
     SdfLayerRefPtr _layer;
     const SdfPath _parentPath;
     const TfToken _fieldName;
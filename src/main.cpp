@@ -15,6 +15,7 @@
 #include "Viewport.h"
 #include "Commands.h"
 #include "Constants.h"
+#include "FrameStatistics.h"
 #include "ResourcesLoader.h"
 #include "CommandLineOptions.h"
 #include "Gui.h"
@@ -180,9 +181,14 @@ int main(int argc, char *const *argv) {
         // Loop until the user closes the window
         while (!editor.IsShutdown()) {
 
-            // Poll and process events
+            // Poll and process events. When nothing has changed, wait for the next event instead of drawing the same frame
             glfwMakeContextCurrent(window);
-            glfwPollEvents();
+            if (editor.IsIdle()) {
+                GetFrameStatistics().idleWaits++;
+                glfwWaitEventsTimeout(IdleEventsTimeout);
+            } else {
+                glfwPollEvents();
+            }
 
             // Render the viewports first as textures
             ImGui_ImplGlfw_RestoreCallbacks(window);
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <limits>
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/gprim.h>
+#include <pxr/usd/usdGeom/imageable.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointInstancer.h>
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include "BoundingVolumeHierarchy.h"
+
+// Maximum number of primitives in a leaf
+static constexpr size_t MaxLeafSize = 4;
+
+// Above this number of changed prims the hierarchy is built again instead of refit
+static constexpr size_t MaxChangedPaths = 1024;
+
+// Closest triangle of the mesh hit by the ray, the polygons are triangulated as fans
+static bool IntersectMesh(const UsdGeomMesh &mesh, const GfMatrix4d &localToWorld, const GfRay &ray, UsdTimeCode timeCode,
+                          double *distance) {
+    VtVec3fArray points;
+    VtIntArray faceVertexCounts;
+    VtIntArray faceVertexIndices;
+    if (!mesh || !mesh.GetPointsAttr().Get(&points, timeCode) || !mesh.GetFaceVertexCountsAttr().Get(&faceVertexCounts, timeCode) ||
+        !mesh.GetFaceVertexIndicesAttr().Get(&faceVertexIndices, timeCode)) {
+        return false;
+    }
+    // The distances along the ray are the same in the local space of the mesh
+    GfRay localRay(ray);
+    localRay.Transform(localToWorld.GetInverse());
+    bool hit = false;
+    double closestDistance = std::numeric_limits<double>::max();
+    size_t offset = 0;
+    for (const int count : faceVertexCounts) {
+        if (count < 0 || offset + count > faceVertexIndices.size())
+            break;
+        for (int i = 1; i + 1 < count; ++i) {
+            const int i0 = faceVertexIndices[offset];
+            const int i1 = faceVertexIndices[offset + i];
+            const int i2 = faceVertexIndices[offset + i + 1];
+            if (i0 < 0 || i1 < 0 || i2 < 0 || std::max({i0, i1, i2}) >= static_cast<int>(points.size()))
+                continue;
+            double triangleDistance = 0.0;
+            if (localRay.Intersect(GfVec3d(points[i0]), GfVec3d(points[i1]), GfVec3d(points[i2]), &triangleDistance) &&
+                triangleDistance < closestDistance) {
+                closestDistance = triangleDistance;
+                hit = true;
+            }
+        }
+        offset += count;
+    }
+    if (hit && distance) {
+        *distance = closestDistance;
+    }
+    return hit;
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy() { TfNotice::Revoke(_objectsChangedKey); }
+
+void BoundingVolumeHierarchy::Update(const UsdStageRefPtr &stage, UsdTimeCode timeCode, const TfTokenVector &purposes,
+                                     BoundingBoxCache &boundingBoxCache) {
+    if (get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _stage = stage;
+        if (stage) {
+            _objectsChangedKey =
+                TfNotice::Register(TfCreateWeakPtr(this), &BoundingVolumeHierarchy::OnObjectsChanged, UsdStageWeakPtr(stage));
+        }
+        _needsBuild = true;
+    }
+    if (timeCode != _timeCode || purposes != _purposes) {
+        _timeCode = timeCode;
+        _purposes = purposes;
+        _needsBuild = true;
+    }
+    if (!stage) {
+        _nodes.clear();
+        _primitives.clear();
+        _primitivesByPath.clear();
+    } else if (_needsBuild) {
+        Build(stage, boundingBoxCache);
+    } else if (!_changedPaths.empty()) {
+        Refit(stage, boundingBoxCache);
+    }
+}
+
+void BoundingVolumeHierarchy::UpdateBound(Primitive &primitive, const UsdStageRefPtr &stage,
+                                          BoundingBoxCache &boundingBoxCache) const {
+    primitive.bound = boundingBoxCache.ComputeWorldBound(stage, primitive.path, _timeCode);
+    primitive.range = primitive.bound.ComputeAlignedRange();
+}
+
+void BoundingVolumeHierarchy::Build(const UsdStageRefPtr &stage, BoundingBoxCache &boundingBoxCache) {
+    TRACE_FUNCTION();
+    _nodes.clear();
+    _primitives.clear();
+    _primitivesByPath.clear();
+    _changedPaths.clear();
+
+    // The prims which are not drawn are skipped with their descendants. The prims which are not imageable, like the
+    // untyped groups, have no visibility or purpose and their descendants are traversed.
+    UsdPrimRange range(stage->GetPseudoRoot(), UsdTraverseInstanceProxies(UsdPrimDefaultPredicate));
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        if (it->IsPseudoRoot())
+            continue;
+        const UsdGeomImageable imageable(*it);
+        TfToken visibility;
+        TfToken purpose;
+        if (imageable && ((imageable.GetVisibilityAttr().Get(&visibility, _timeCode) && visibility == UsdGeomTokens->invisible) ||
+                          (imageable.GetPurposeAttr().Get(&purpose) &&
+                           std::find(_purposes.begin(), _purposes.end(), purpose) == _purposes.end()))) {
+            it.PruneChildren();
+            continue;
+        }
+        const bool isPointInstancer = it->IsA<UsdGeomPointInstancer>();
+        if (isPointInstancer || it->IsA<UsdGeomGprim>()) {
+            Primitive primitive;
+            primitive.path = it->GetPath();
+            primitive.isMesh = it->IsA<UsdGeomMesh>();
+            _primitives.push_back(primitive);
+        }
+        // The prototypes of a point instancer are picked with the instancer
+        if (isPointInstancer) {
+            it.PruneChildren();
+        }
+    }
+
+    // Computing the bound of the pseudo root populates the bounds of all the prims in parallel
+    boundingBoxCache.ComputeWorldBound(stage, SdfPath::AbsoluteRootPath(), _timeCode);
+    for (Primitive &primitive : _primitives) {
+        UpdateBound(primitive, stage, boundingBoxCache);
+    }
+    if (!_primitives.empty()) {
+        BuildNode(0, _primitives.size());
+    }
+
+    _primitivesByPath.resize(_primitives.size());
+    for (size_t i = 0; i < _primitives.size(); ++i) {
+        _primitivesByPath[i] = i;
+    }
+    std::sort(_primitivesByPath.begin(), _primitivesByPath.end(),
+              [this](size_t left, size_t right) { return _primitives[left].path < _primitives[right].path; });
+    _needsBuild = false;
+    _buildCount++;
+}
+
+// The primitives are split at the median of their centers on the longest axis
+size_t BoundingVolumeHierarchy::BuildNode(size_t first, size_t count) {
+    const size_t nodeIndex = _nodes.size();
+    _nodes.emplace_back();
+    GfRange3d range;
+    GfRange3d centers;
+    for (size_t i = first; i < first + count; ++i) {
+        range.UnionWith(_primitives[i].range);
+        if (!_primitives[i].range.IsEmpty()) {
+            centers.UnionWith(_primitives[i].range.GetMidpoint());
+        }
+    }
+    _nodes[nodeIndex].range = range;
+    if (count <= MaxLeafSize || centers.IsEmpty()) {
+        _nodes[nodeIndex].first = first;
+        _nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+    const GfVec3d size = centers.GetSize();
+    const int axis = size[0] > size[1] ? (size[0] > size[2] ? 0 : 2) : (size[1] > size[2] ? 1 : 2);
+    const size_t half = count / 2;
+    std::nth_element(_primitives.begin() + first, _primitives.begin() + first + half, _primitives.begin() + first + count,
+                     [axis](const Primitive &left, const Primitive &right) {
+                         return left.range.GetMidpoint()[axis] < right.range.GetMidpoint()[axis];
+                     });
+    BuildNode(first, half);
+    const size_t secondChild = BuildNode(first + half, count - half);
+    _nodes[nodeIndex].secondChild = secondChild;
+    return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::Refit(const UsdStageRefPtr &stage, BoundingBoxCache &boundingBoxCache) {
+    TRACE_FUNCTION();
+    const auto IsBefore = [this](size_t index, const SdfPath &path) { return _primitives[index].path < path; };
+    for (const SdfPath &changedPath : _changedPaths) {
+        // The prims under the changed path
+        auto it = std::lower_bound(_primitivesByPath.begin(), _primitivesByPath.end(), changedPath, IsBefore);
+        for (; it != _primitivesByPath.end() && _primitives[*it].path.HasPrefix(changedPath); ++it) {
+            UpdateBound(_primitives[*it], stage, boundingBoxCache);
+        }
+        // and the prims above it, as the bound of a point instancer depends on its prototypes
+        for (SdfPath path = changedPath.GetParentPath(); !path.IsEmpty() && !path.IsAbsoluteRootPath(); path = path.GetParentPath()) {
+            it = std::lower_bound(_primitivesByPath.begin(), _primitivesByPath.end(), path, IsBefore);
+            if (it != _primitivesByPath.end() && _primitives[*it].path == path) {
+                UpdateBound(_primitives[*it], stage, boundingBoxCache);
+            }
+        }
+    }
+    _changedPaths.clear();
+
+    // The children are stored after their parent, the nodes are refit from the last one
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        Node &node = _nodes[i];
+        if (node.count) {
+            node.range = GfRange3d();
+            for (size_t primitiveIndex = node.first; primitiveIndex < node.first + node.count; ++primitiveIndex) {
+                node.range.UnionWith(_primitives[primitiveIndex].range);
+            }
+        } else {
+            node.range = GfRange3d::GetUnion(_nodes[i + 1].range, _nodes[node.secondChild].range);
+        }
+    }
+    _refitCount++;
+}
+
+// A resync or a change of the visibility or the purpose rebuilds the hierarchy, the other changes are refit
+void BoundingVolumeHierarchy::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    if (_needsBuild)
+        return;
+    if (!notice.GetResyncedPaths().empty()) {
+        _needsBuild = true;
+        _changedPaths.clear();
+        return;
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        const bool isPropertyPath = path.IsPropertyPath();
+        if (path.IsAbsoluteRootPath() ||
+            (isPropertyPath && (path.GetNameToken() == UsdGeomTokens->visibility || path.GetNameToken() == UsdGeomTokens->purpose))) {
+            _needsBuild = true;
+            _changedPaths.clear();
+            return;
+        }
+        if (isPropertyPath) {
+            _changedPaths.insert(path.GetPrimPath());
+        }
+    }
+    // The list is not consumed when the hierarchy isn't used for picking, it is capped by a rebuild
+    if (_changedPaths.size() > MaxChangedPaths) {
+        _needsBuild = true;
+        _changedPaths.clear();
+    }
+}
+
+bool BoundingVolumeHierarchy::IntersectPrimitive(const Primitive &primitive, const GfRay &ray, double *distance) const {
+    double enterDistance = 0.0;
+    double exitDistance = 0.0;
+    if (primitive.range.IsEmpty() || !ray.Intersect(primitive.bound, &enterDistance, &exitDistance))
+        return false;
+    if (primitive.isMesh) {
+        return _stage && IntersectMesh(UsdGeomMesh(_stage->GetPrimAtPath(primitive.path)), primitive.bound.GetMatrix(), ray,
+                                       _timeCode, distance);
+    }
+    *distance = std::max(enterDistance, 0.0);
+    return true;
+}
+
+bool BoundingVolumeHierarchy::IntersectRay(const GfRay &ray, SdfPath &outHitPrimPath, double *outDistance) const {
+    TRACE_FUNCTION();
+    const Primitive *closest = nullptr;
+    double closestDistance = std::numeric_limits<double>::max();
+    std::vector<size_t> nodesToVisit;
+    if (!_nodes.empty()) {
+        nodesToVisit.push_back(0);
+    }
+    while (!nodesToVisit.empty()) {
+        const size_t nodeIndex = nodesToVisit.back();
+        nodesToVisit.pop_back();
+        const Node &node = _nodes[nodeIndex];
+        double enterDistance = 0.0;
+        double exitDistance = 0.0;
+        if (node.range.IsEmpty() || !ray.Intersect(node.range, &enterDistance, &exitDistance) ||
+            enterDistance > closestDistance) {
+            continue;
+        }
+        if (node.count) {
+            for (size_t i = node.first; i < node.first + node.count; ++i) {
+                double distance = 0.0;
+                if (IntersectPrimitive(_primitives[i], ray, &distance) && distance < closestDistance) {
+                    closest = &_primitives[i];
+                    closestDistance = distance;
+                }
+            }
+        } else {
+            nodesToVisit.push_back(node.secondChild);
+            nodesToVisit.push_back(nodeIndex + 1);
+        }
+    }
+    if (!closest)
+        return false;
+    outHitPrimPath = closest->path;
+    if (outDistance) {
+        *outDistance = closestDistance;
+    }
+    return true;
+}
+
+SdfPathVector BoundingVolumeHierarchy::IntersectFrustum(const GfFrustum &frustum) const {
+    TRACE_FUNCTION();
+    SdfPathVector paths;
+    std::vector<size_t> nodesToVisit;
+    if (!_nodes.empty()) {
+        nodesToVisit.push_back(0);
+    }
+    while (!nodesToVisit.empty()) {
+        const size_t nodeIndex = nodesToVisit.back();
+        nodesToVisit.pop_back();
+        const Node &node = _nodes[nodeIndex];
+        if (node.range.IsEmpty() || !frustum.Intersects(GfBBox3d(node.range)))
+            continue;
+        if (node.count) {
+            for (size_t i = node.first; i < node.first + node.count; ++i) {
+                if (!_primitives[i].range.IsEmpty() && frustum.Intersects(_primitives[i].bound)) {
+                    paths.push_back(_primitives[i].path);
+                }
+            }
+        } else {
+            nodesToVisit.push_back(node.secondChild);
+            nodesToVisit.push_back(nodeIndex + 1);
+        }
+    }
+    return paths;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <unordered_set>
+#include <vector>
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/range3d.h>
+#include <pxr/base/gf/ray.h>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+#include "BoundingBoxCache.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Bounding volume hierarchy over the world bounds of the gprims and point instancers of a stage, used to pick on the
+/// cpu instead of rendering an id pass with hydra.
+/// It is built on the first query following a resync or a change of the time code or of the drawn purposes. An edit
+/// of the attributes of a prim only refits the bounds of the prims under it and of the nodes above them.
+///
+class BoundingVolumeHierarchy : public TfWeakBase {
+  public:
+    BoundingVolumeHierarchy() = default;
+    ~BoundingVolumeHierarchy();
+
+    // Delete copy
+    BoundingVolumeHierarchy(const BoundingVolumeHierarchy &) = delete;
+    BoundingVolumeHierarchy &operator=(const BoundingVolumeHierarchy &) = delete;
+
+    /// Build or refit the hierarchy if the stage has changed since the last update. Only the prims with one of the
+    /// purposes are added. The bounds are read from the bounding box cache.
+    void Update(const UsdStageRefPtr &stage, UsdTimeCode timeCode, const TfTokenVector &purposes,
+                BoundingBoxCache &boundingBoxCache);
+
+    /// Returns the closest prim hit by the ray and its distance along the ray. The meshes are intersected with their
+    /// triangles, the other prims with their bounds.
+    bool IntersectRay(const GfRay &ray, SdfPath &outHitPrimPath, double *outDistance = nullptr) const;
+
+    /// Returns the prims with bounds intersecting the frustum
+    SdfPathVector IntersectFrustum(const GfFrustum &frustum) const;
+
+    /// Statistics, for debugging
+    size_t GetPrimCount() const { return _primitives.size(); }
+    size_t GetNodeCount() const { return _nodes.size(); }
+    size_t GetBuildCount() const { return _buildCount; }
+    size_t GetRefitCount() const { return _refitCount; }
+
+  private:
+    struct Primitive {
+        SdfPath path;
+        GfBBox3d bound;  // Extent of the prim with its local to world matrix
+        GfRange3d range; // World aligned range of the bound
+        bool isMesh = false;
+    };
+
+    // The first child of an inner node is stored after it, the second one at secondChild
+    struct Node {
+        GfRange3d range;
+        size_t first = 0; // First primitive of a leaf
+        size_t count = 0; // Number of primitives of a leaf, 0 for an inner node
+        size_t secondChild = 0;
+    };
+
+    void Build(const UsdStageRefPtr &stage, BoundingBoxCache &boundingBoxCache);
+    size_t BuildNode(size_t first, size_t count);
+    void Refit(const UsdStageRefPtr &stage, BoundingBoxCache &boundingBoxCache);
+    void UpdateBound(Primitive &primitive, const UsdStageRefPtr &stage, BoundingBoxCache &boundingBoxCache) const;
+    bool IntersectPrimitive(const Primitive &primitive, const GfRay &ray, double *distance) const;
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    std::vector<Node> _nodes;
+    std::vector<Primitive> _primitives; // Ordered by leaf
+    std::vector<size_t> _primitivesByPath; // Indices of the primitives sorted by path, the prims under a path are contiguous
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    UsdTimeCode _timeCode = UsdTimeCode::Default();
+    TfTokenVector _purposes;
+    bool _needsBuild = true;
+    std::unordered_set<SdfPath, SdfPath::Hash> _changedPaths; // Prims whose bounds and the bounds of their descendants must be refit
+
+    size_t _buildCount = 0;
+    size_t _refitCount = 0;
+};
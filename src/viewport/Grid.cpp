@@ -54,9 +54,9 @@ void Grid::SetZIsUp(bool zIsUp) {
 
 
 void Grid::Render(Viewport &viewport) {
-    const auto &camera = viewport.GetViewportCamera();
-    auto mv = camera.GetFrustum().ComputeViewMatrix();
-    auto proj = camera.GetFrustum().ComputeProjectionMatrix();
+    const ViewportViewState &viewState = viewport.GetViewState();
+    const GfMatrix4d &mv = viewState.viewMatrix;
+    const GfMatrix4d &proj = viewState.projectionMatrix;
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glUseProgram(_programShader);
@@ -42,6 +42,7 @@ ImagingSettings::ImagingSettings() {
     showGizmos = true;
     showUI = true;
     showViewportMenu = false;
+    pickingBackend = HydraPicking;
 
     // TODO: set color correction as well
 
@@ -144,6 +145,13 @@ void DrawImagingSettings(UsdImagingGLEngine &renderer, ImagingSettings &renderpa
     ImGui::Checkbox("Enable camera light", &renderparams.enableCameraLight);
     ImGui::Checkbox("Show grid", &renderparams.showGrid);
     ImGui::Checkbox("Show gizmos", &renderparams.showGizmos);
+
+    ImGui::Separator();
+    static const char *PickingBackendStrings[] = {"Hydra", "Cpu bvh"};
+    int pickingBackend = renderparams.pickingBackend;
+    if (ImGui::Combo("Picking", &pickingBackend, PickingBackendStrings, IM_ARRAYSIZE(PickingBackendStrings))) {
+        renderparams.pickingBackend = static_cast<ImagingSettings::PickingBackend>(pickingBackend);
+    }
 }
 
 void DrawRendererSelectionCombo(UsdImagingGLEngine &renderer) {
@@ -25,6 +25,10 @@ struct ImagingSettings : UsdImagingGLRenderParams {
     bool showUI;
     bool showViewportMenu;
 
+    // Picking, with a hydra id render or on the cpu with a bounding volume hierarchy of the stage
+    enum PickingBackend { HydraPicking = 0, BvhPicking };
+    PickingBackend pickingBackend;
+
 private:
     GlfSimpleLightVector _lights;
 };
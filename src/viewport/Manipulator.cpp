@@ -1 +1,76 @@
+#include <algorithm>
+#include <set>
+
 #include "Manipulator.h"
+#include "Commands.h"
+#include "Viewport.h"
+
+std::vector<UsdGeomXformable> GetSelectedXformables(Viewport &viewport) {
+    std::vector<UsdGeomXformable> xformables;
+    const UsdStageRefPtr &stage = viewport.GetCurrentStage();
+    if (!stage)
+        return xformables;
+    Selection &selection = viewport.GetSelection();
+    SdfPathVector paths = selection.GetSelectedPaths(stage);
+    // The anchor prim is moved first in the list
+    const SdfPath anchorPath = selection.GetAnchorPrimPath(stage);
+    std::stable_partition(paths.begin(), paths.end(), [&anchorPath](const SdfPath &path) { return path == anchorPath; });
+    std::set<SdfPath> xformablePaths;
+    for (const SdfPath &path : paths) {
+        if (UsdGeomXformable xformable = UsdGeomXformable(stage->GetPrimAtPath(path))) {
+            xformables.push_back(xformable);
+            xformablePaths.insert(path);
+        }
+    }
+    const auto HasXformableAncestor = [&xformablePaths](const UsdGeomXformable &xformable) {
+        for (SdfPath path = xformable.GetPath().GetParentPath(); !path.IsEmpty(); path = path.GetParentPath()) {
+            if (xformablePaths.count(path))
+                return true;
+        }
+        return false;
+    };
+    xformables.erase(std::remove_if(xformables.begin(), xformables.end(), HasXformableAncestor), xformables.end());
+    return xformables;
+}
+
+void ManipulatorEditSession::Begin(const UsdStageRefPtr &stage, const std::vector<UsdGeomXformable> &xformables,
+                                   UsdTimeCode viewportTimeCode) {
+    // The time samples are queried once for the whole session instead of at every mouse move
+    _editionTimeCodes.clear();
+    for (const UsdGeomXformable &xformable : xformables) {
+        std::vector<double> timeSamples;
+        if (xformable) {
+            xformable.GetTimeSamples(&timeSamples);
+        }
+        _editionTimeCodes.push_back(timeSamples.empty() ? UsdTimeCode::Default() : viewportTimeCode);
+    }
+    _pendingValue = VtValue();
+    _authorPendingValue = nullptr;
+    _authoredValue = VtValue();
+    _isActive = true;
+    BeginEdition(stage);
+}
+
+void ManipulatorEditSession::End() {
+    if (_isActive) {
+        Flush();
+        EndEdition();
+        _authorPendingValue = nullptr;
+        _isActive = false;
+    }
+}
+
+void ManipulatorEditSession::SetValue(const VtValue &value, std::function<void()> authorValue) {
+    _pendingValue = value;
+    _authorPendingValue = std::move(authorValue);
+}
+
+void ManipulatorEditSession::Flush() {
+    // Each write triggers the stage change processing and a render index update, it is skipped when the mouse
+    // didn't move the manipulator since the previous frame
+    if (_isActive && _authorPendingValue && _pendingValue != _authoredValue) {
+        _authorPendingValue();
+        _authoredValue = _pendingValue;
+    }
+    _authorPendingValue = nullptr;
+}
@@ -1,4 +1,12 @@
 #pragma once
+#include <functional>
+#include <vector>
+#include <pxr/base/vt/value.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/timeCode.h>
+#include <pxr/usd/usdGeom/xformable.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
 
 class Viewport;
 
@@ -33,3 +41,38 @@ struct Manipulator {
     } ManipulatorAxis;
 };
 
+/// Returns the transformable prims of the selection driven by the manipulators, the anchor prim first as it places
+/// the manipulator. The prims having a transformable ancestor in the selection are skipped as they follow it.
+std::vector<UsdGeomXformable> GetSelectedXformables(Viewport &viewport);
+
+///
+/// Edition of the transforms of the selected prims by a manipulator, from the mouse press to the mouse release.
+/// All the writes of the session are recorded in a single undo command. The manipulator submits the new value driving
+/// all the prims at each update, the prims are authored at most once per frame and only if the value differs from the
+/// last authored value. The last submitted value is always authored when the session ends.
+///
+class ManipulatorEditSession {
+  public:
+    void Begin(const UsdStageRefPtr &stage, const std::vector<UsdGeomXformable> &xformables, UsdTimeCode viewportTimeCode);
+    void End();
+
+    bool IsActive() const { return _isActive; }
+
+    /// Time code of the edited values of the xformable at index, the default time code if it is not animated
+    UsdTimeCode GetEditionTimeCode(size_t index) const {
+        return index < _editionTimeCodes.size() ? _editionTimeCodes[index] : UsdTimeCode::Default();
+    }
+
+    /// Submit a new value with the function authoring all the prims
+    void SetValue(const VtValue &value, std::function<void()> authorValue);
+
+    /// Author the last submitted value if it has changed, called once per frame
+    void Flush();
+
+  private:
+    bool _isActive = false;
+    std::vector<UsdTimeCode> _editionTimeCodes;
+    VtValue _pendingValue;
+    std::function<void()> _authorPendingValue;
+    VtValue _authoredValue;
+};
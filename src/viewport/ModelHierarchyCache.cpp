@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <pxr/usd/kind/registry.h>
+#include <pxr/usd/sdf/schema.h>
+#include <pxr/usd/usd/modelAPI.h>
+
+#include "ModelHierarchyCache.h"
+
+ModelHierarchyCache::~ModelHierarchyCache() { TfNotice::Revoke(_objectsChangedKey); }
+
+SdfPath ModelHierarchyCache::GetClosestModelPath(const UsdStageRefPtr &stage, const SdfPath &path, const TfToken &kind) {
+    if (get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _modelPaths.clear();
+        _stage = stage;
+        if (stage) {
+            _objectsChangedKey =
+                TfNotice::Register(TfCreateWeakPtr(this), &ModelHierarchyCache::OnObjectsChanged, UsdStageWeakPtr(stage));
+        }
+    }
+    if (!stage || path.IsEmpty() || path.IsAbsoluteRootPath())
+        return SdfPath::AbsoluteRootPath();
+
+    ModelPaths &modelPaths = _modelPaths[kind];
+    const auto found = modelPaths.find(path);
+    if (found != modelPaths.end())
+        return found->second;
+
+    // The ancestors are cached as well, the other prims under them will find their model in one lookup
+    TfToken primKind;
+    const UsdPrim prim = stage->GetPrimAtPath(path);
+    const SdfPath modelPath = prim && UsdModelAPI(prim).GetKind(&primKind) && KindRegistry::GetInstance().IsA(primKind, kind)
+                                  ? path
+                                  : GetClosestModelPath(stage, path.GetParentPath(), kind);
+    modelPaths[path] = modelPath;
+    return modelPath;
+}
+
+// A kind change modifies the model of all the prims under it, the whole cache is cleared
+void ModelHierarchyCache::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    if (_modelPaths.empty())
+        return;
+    bool kindsChanged = !notice.GetResyncedPaths().empty();
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        if (kindsChanged)
+            break;
+        if (path.IsAbsoluteRootOrPrimPath()) {
+            const TfTokenVector fields = notice.GetChangedFields(path);
+            kindsChanged = std::find(fields.begin(), fields.end(), SdfFieldKeys->Kind) != fields.end();
+        }
+    }
+    if (kindsChanged) {
+        _modelPaths.clear();
+        _invalidationCount++;
+    }
+}
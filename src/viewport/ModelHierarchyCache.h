@@ -0,0 +1,41 @@
+#pragma once
+#include <map>
+#include <unordered_map>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Closest model ancestor of the prims of a stage for each kind, used to resolve the picked prims in the model and
+/// assembly pick modes. The ancestors are found on demand and kept until a kind is changed or a prim is resynced.
+///
+class ModelHierarchyCache : public TfWeakBase {
+  public:
+    ModelHierarchyCache() = default;
+    ~ModelHierarchyCache();
+
+    // Delete copy
+    ModelHierarchyCache(const ModelHierarchyCache &) = delete;
+    ModelHierarchyCache &operator=(const ModelHierarchyCache &) = delete;
+
+    /// Returns path if its kind is kind, otherwise its closest ancestor of this kind or the pseudo root path
+    SdfPath GetClosestModelPath(const UsdStageRefPtr &stage, const SdfPath &path, const TfToken &kind);
+
+    /// Number of times the cache was cleared by a stage change, for debugging
+    size_t GetInvalidationCount() const { return _invalidationCount; }
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    using ModelPaths = std::unordered_map<SdfPath, SdfPath, SdfPath::Hash>;
+    std::map<TfToken, ModelPaths> _modelPaths; // Per kind
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    size_t _invalidationCount = 0;
+};
@@ -35,9 +35,9 @@ PositionManipulator::~PositionManipulator() {}
 bool PositionManipulator::IsMouseOver(const Viewport &viewport) {
 
     if (_xformAPI || _xformable) {
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
-        const auto mv = frustum.ComputeViewMatrix();
-        const auto proj = frustum.ComputeProjectionMatrix();
+        const ViewportViewState &viewState = viewport.GetViewState();
+        const GfMatrix4d &mv = viewState.viewMatrix;
+        const GfMatrix4d &proj = viewState.projectionMatrix;
 
         const auto toWorld = ComputeManipulatorToWorldTransform(viewport);
 
@@ -78,22 +78,21 @@ bool PositionManipulator::IsMouseOver(const Viewport &viewport) {
 
 // Same as rotation manipulator now -- TODO : share in a common class
 void PositionManipulator::OnSelectionChange(Viewport &viewport) {
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
+    _xformables = GetSelectedXformables(viewport);
+    _xformable = _xformables.empty() ? UsdGeomXformable() : _xformables.front();
+    _xformAPI = UsdGeomXformCommonAPI(_xformable);
 }
 
 GfMatrix4d PositionManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
     if (_xformable) {
         const auto currentTime = viewport.GetCurrentTimeCode();
-        GfMatrix4d localTransform;
+        TransformCache &xformCache = viewport.GetTransformCache();
         bool resetsXformStack = false;
-        _xformable.GetLocalTransformation(&localTransform, &resetsXformStack, currentTime);
+        const GfMatrix4d localTransform = xformCache.GetLocalTransformation(_xformable.GetPrim(), currentTime, &resetsXformStack);
         const GfVec3d translation = localTransform.ExtractTranslation();
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         // const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot); // Do we need to get the pivot ?
-        const auto parentToWorld = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorld = xformCache.GetParentToWorldTransform(_xformable.GetPrim(), currentTime);
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = /* pivotMat * */ transMat * parentToWorld; // TODO pivot ?? or not pivot ???
@@ -125,9 +124,9 @@ template <int Axis> inline ImColor AxisColor(int selectedAxis) {
 void PositionManipulator::OnDrawFrame(const Viewport &viewport) {
 
     if (_xformAPI || _xformable) {
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
-        const auto mv = frustum.ComputeViewMatrix();
-        const auto proj = frustum.ComputeProjectionMatrix();
+        const ViewportViewState &viewState = viewport.GetViewState();
+        const GfMatrix4d &mv = viewState.viewMatrix;
+        const GfMatrix4d &proj = viewState.projectionMatrix;
 
         const auto toWorld = ComputeManipulatorToWorldTransform(viewport);
 
@@ -162,20 +161,39 @@ void PositionManipulator::OnDrawFrame(const Viewport &viewport) {
     }
 }
 
+// Author the translation with the common api or in the single transform op of the prim
+static void SetTranslation(const UsdGeomXformable &xformable, const GfVec3d &translation, UsdTimeCode timeCode) {
+    UsdGeomXformCommonAPI xformAPI(xformable);
+    if (xformAPI) {
+        xformAPI.SetTranslate(translation, timeCode);
+    } else {
+        bool reset = false;
+        auto ops = xformable.GetOrderedXformOps(&reset);
+        if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
+            GfMatrix4d current = ops[0].GetOpTransform(timeCode);
+            current.SetTranslateOnly(translation); // TODO: what happens if there is a pivot ???
+            ops[0].Set(current, timeCode);
+        }
+    }
+}
+
 void PositionManipulator::OnBeginEdition(Viewport &viewport) {
-    // Save original translation values
-    GfVec3f scale, pivot, rotation;
-    GfMatrix4d localTransform;
-    bool resetsXformStack = false;
-    _xformable.GetLocalTransformation(&localTransform, &resetsXformStack, viewport.GetCurrentTimeCode());
-    _translationOnBegin = localTransform.ExtractTranslation();
+    // Save original translation values of all the driven prims
+    TransformCache &xformCache = viewport.GetTransformCache();
+    _translationsOnBegin.clear();
+    for (const UsdGeomXformable &xformable : _xformables) {
+        bool resetsXformStack = false;
+        const GfMatrix4d localTransform =
+            xformCache.GetLocalTransformation(xformable.GetPrim(), viewport.GetCurrentTimeCode(), &resetsXformStack);
+        _translationsOnBegin.push_back(localTransform.ExtractTranslation());
+    }
 
     // Save mouse position on selected axis
     const GfMatrix4d objectTransform = ComputeManipulatorToWorldTransform(viewport);
     _axisLine = GfLine(objectTransform.ExtractTranslation(), objectTransform.GetRow3(_selectedAxis));
     ProjectMouseOnAxis(viewport, _originMouseOnAxis);
 
-    BeginEdition(viewport.GetCurrentStage());
+    _editSession.Begin(viewport.GetCurrentStage(), _xformables, viewport.GetCurrentTimeCode());
 }
 
 Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
@@ -195,24 +213,22 @@ Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
         _axisLine.FindClosestPoint(mouseOnAxis, &cur);
         double sign = cur > ori ? 1.0 : -1.0;
 
-        GfVec3d translation = _translationOnBegin;
-        translation[_selectedAxis] += sign * (_originMouseOnAxis - mouseOnAxis).GetLength();
-        if (_xformAPI) {
-            _xformAPI.SetTranslate(translation, GetEditionTimeCode(viewport));
-        } else {
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
-                GfMatrix4d current = ops[0].GetOpTransform(GetEditionTimeCode(viewport));
-                current.SetTranslateOnly(translation); // TODO: what happens if there is a pivot ???
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+        // All the prims are moved by the same offset along the selected axis of their parent space
+        const double offset = sign * (_originMouseOnAxis - mouseOnAxis).GetLength();
+        const ManipulatorAxis selectedAxis = _selectedAxis;
+        _editSession.SetValue(VtValue(offset), [this, offset, selectedAxis]() {
+            for (size_t i = 0; i < _xformables.size() && i < _translationsOnBegin.size(); ++i) {
+                GfVec3d translation = _translationsOnBegin[i];
+                translation[selectedAxis] += offset;
+                SetTranslation(_xformables[i], translation, _editSession.GetEditionTimeCode(i));
             }
-        }
+        });
+        _editSession.Flush();
     }
     return this;
 };
 
-void PositionManipulator::OnEndEdition(Viewport &) { EndEdition(); };
+void PositionManipulator::OnEndEdition(Viewport &) { _editSession.End(); };
 
 ///
 void PositionManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &linePoint) {
@@ -220,19 +236,9 @@ void PositionManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &
         GfVec3d rayPoint;
         double a = 0;
         double b = 0;
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
+        const auto &frustum = viewport.GetViewState().frustum;
         const auto mouseRay = frustum.ComputeRay(viewport.GetMousePosition());
         GfFindClosestPoints(mouseRay, _axisLine, &rayPoint, &linePoint, &a, &b);
     }
 }
 
-UsdTimeCode PositionManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return viewport.GetCurrentTimeCode();
-    }
-}
@@ -35,14 +35,16 @@ class PositionManipulator : public Manipulator {
     void ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &closestPoint);
     GfMatrix4d ComputeManipulatorToWorldTransform(const Viewport &viewport);
 
-    UsdTimeCode GetEditionTimeCode(const Viewport &viewport);
-
     ManipulatorAxis _selectedAxis;
 
     GfVec3d _originMouseOnAxis;
-    GfVec3d _translationOnBegin;
+    std::vector<GfVec3d> _translationsOnBegin;
     GfLine _axisLine;
 
+    // Transformable prims of the selection, the first one places the manipulator
+    std::vector<UsdGeomXformable> _xformables;
     UsdGeomXformable _xformable;
     UsdGeomXformCommonAPI _xformAPI;
+
+    ManipulatorEditSession _editSession;
 };
@@ -50,7 +50,7 @@ bool RotationManipulator::IsMouseOver(const Viewport &viewport) {
 
     if (_xformable) {
         const GfVec2d mousePosition = viewport.GetMousePosition();
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
+        const auto &frustum = viewport.GetViewState().frustum;
         const GfRay ray = frustum.ComputeRay(mousePosition);
         const auto manipulatorCoordinates = ComputeManipulatorToWorldTransform(viewport);
         const GfVec3d xAxis = manipulatorCoordinates.GetRow3(0);
@@ -78,10 +78,9 @@ bool RotationManipulator::IsMouseOver(const Viewport &viewport) {
 
 void RotationManipulator::OnSelectionChange(Viewport &viewport) {
     // TODO: we should set here if the new selection will be editable or not
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(_xformAPI.GetPrim());
+    _xformables = GetSelectedXformables(viewport);
+    _xformable = _xformables.empty() ? UsdGeomXformable() : _xformables.front();
+    _xformAPI = UsdGeomXformCommonAPI(_xformable);
 }
 
 GfMatrix4d RotationManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
@@ -97,8 +96,7 @@ GfMatrix4d RotationManipulator::ComputeManipulatorToWorldTransform(const Viewpor
 
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot);
-        // const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-        const auto parentToWorldMat = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorldMat = viewport.GetTransformCache().GetParentToWorldTransform(_xformable.GetPrim(), currentTime);
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = rotMat * pivotMat * transMat * parentToWorldMat;
@@ -158,17 +156,17 @@ template <int Axis> inline ImColor AxisColor(int selectedAxis) {
 void RotationManipulator::OnDrawFrame(const Viewport &viewport) {
 
     if (_xformable) {
-        const auto &camera = viewport.GetViewportCamera();
-        auto mv = camera.GetFrustum().ComputeViewMatrix();
-        auto proj = camera.GetFrustum().ComputeProjectionMatrix();
+        const ViewportViewState &viewState = viewport.GetViewState();
+        const GfMatrix4d &mv = viewState.viewMatrix;
+        const GfMatrix4d &proj = viewState.projectionMatrix;
         auto manipulatorCoordinates = ComputeManipulatorToWorldTransform(viewport);
         auto origin = manipulatorCoordinates.ExtractTranslation();
-        auto cameraPosition = mv.GetInverse().ExtractTranslation();
+        auto cameraPosition = viewState.inverseViewMatrix.ExtractTranslation();
 
         // Circles must be scaled to keep the same screen size
         double scale = viewport.ComputeScaleFactor(origin, axisSize);
 
-        const auto toWorld = ComputeManipulatorToWorldTransform(viewport);
+        const auto &toWorld = manipulatorCoordinates;
 
         ImDrawList *draw_list = ImGui::GetWindowDrawList();
         ImGuiViewport *viewport = ImGui::GetMainViewport();
@@ -197,7 +195,7 @@ GfVec3d RotationManipulator::ComputeClockHandVector(Viewport &viewport) {
     double distance = 0.0;
 
     const GfVec2d mousePosition = viewport.GetMousePosition();
-    const GfFrustum frustum = viewport.GetViewportCamera().GetFrustum();
+    const GfFrustum &frustum = viewport.GetViewState().frustum;
     const GfRay ray = frustum.ComputeRay(mousePosition);
     if (ray.Intersect(plane, &distance)) {
         const auto intersection = ray.GetPoint(distance);
@@ -222,18 +220,71 @@ void RotationManipulator::OnBeginEdition(Viewport &viewport) {
 
         // Compute rotation starting point
         _rotateFrom = ComputeClockHandVector(viewport);
+    }
 
-        // Save the rotation values
-        GfVec3d translation;
-        GfVec3f rotation, scale, pivot;
-        UsdGeomXformCommonAPI::RotationOrder rotOrder;
-        _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale, &pivot, &rotOrder,
-                                                GetViewportTimeCode(viewport));
+    // Save the rotation values of all the driven prims
+    _rotationsOnBegin.clear();
+    for (const UsdGeomXformable &xformable : _xformables) {
+        PrimRotation primRotation;
+        GfVec3f pivot;
+        UsdGeomXformCommonAPI(xformable).GetXformVectorsByAccumulation(&primRotation.translation, &primRotation.rotation,
+                                                                       &primRotation.scale, &pivot, &primRotation.rotOrder,
+                                                                       GetViewportTimeCode(viewport));
+        primRotation.matrixOnBegin = UsdGeomXformOp::GetOpTransform(
+            UsdGeomXformCommonAPI::ConvertRotationOrderToOpType(primRotation.rotOrder), VtValue(primRotation.rotation));
+        _rotationsOnBegin.push_back(primRotation);
+    }
+    _editSession.Begin(viewport.GetCurrentStage(), _xformables, GetViewportTimeCode(viewport));
+}
 
-        _rotateMatrixOnBegin =
-            UsdGeomXformOp::GetOpTransform(UsdGeomXformCommonAPI::ConvertRotationOrderToOpType(rotOrder), VtValue(rotation));
+// Rotate the prim at index by angle around its own selected axis
+void RotationManipulator::SetRotation(size_t index, double angle) {
+    PrimRotation &primRotation = _rotationsOnBegin[index];
+
+    // Compute rotation axis in local coordinates
+    // We use the plane normal as the rotation between _rotateFrom and rotateTo might not land exactly on the rotation axis
+    const GfVec3d xAxis = primRotation.matrixOnBegin.GetRow3(0);
+    const GfVec3d yAxis = primRotation.matrixOnBegin.GetRow3(1);
+    const GfVec3d zAxis = primRotation.matrixOnBegin.GetRow3(2);
+
+    GfVec3d localPlaneNormal = xAxis; // default init
+    if (_selectedAxis == XAxis) {
+        localPlaneNormal = xAxis;
+    } else if (_selectedAxis == YAxis) {
+        localPlaneNormal = yAxis;
+    } else if (_selectedAxis == ZAxis) {
+        localPlaneNormal = zAxis;
+    }
+
+    const GfRotation deltaRotation(localPlaneNormal, angle);
+    // NOTE: should that be matrixOnBegin * deltaRotation instead ? the formula for opTrans use this order
+    const GfMatrix4d resultingRotation = GfMatrix4d(1.0).SetRotate(deltaRotation) * primRotation.matrixOnBegin;
+
+    // The last authored rotation values give a hint to the decompose function
+    double thetaTw = GfDegreesToRadians(primRotation.rotation[0]);
+    double thetaFB = GfDegreesToRadians(primRotation.rotation[1]);
+    double thetaLR = GfDegreesToRadians(primRotation.rotation[2]);
+    double thetaSw = 0.0;
+    // Decompose the matrix in angle values
+    GfRotation::DecomposeRotation(resultingRotation, xAxis, yAxis, zAxis, 1.0, &thetaTw, &thetaFB, &thetaLR, &thetaSw, true);
+    primRotation.rotation = GfVec3f(GfRadiansToDegrees(thetaTw), GfRadiansToDegrees(thetaFB), GfRadiansToDegrees(thetaLR));
+
+    const UsdGeomXformable &xformable = _xformables[index];
+    const UsdTimeCode editionTimeCode = _editSession.GetEditionTimeCode(index);
+    UsdGeomXformCommonAPI xformAPI(xformable);
+    if (xformAPI) {
+        xformAPI.SetRotate(primRotation.rotation, primRotation.rotOrder, editionTimeCode);
+    } else { // Modify only if we have a single matrix
+        bool reset = false;
+        auto ops = xformable.GetOrderedXformOps(&reset);
+        if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
+            // [ "xformOp:translate", "xformOp:translate:pivot", "xformOp:rotateXYZ",
+            // "xformOp:scale", "!invert!xformOp:translate:pivot" ] - No pivot here
+            GfMatrix4d current = GfMatrix4d().SetScale(primRotation.scale) * primRotation.matrixOnBegin *
+                                 GfMatrix4d(1.0).SetRotate(deltaRotation) * GfMatrix4d().SetTranslate(primRotation.translation);
+            ops[0].Set(current, editionTimeCode);
+        }
     }
-    BeginEdition(viewport.GetCurrentStage());
 }
 
 Manipulator *RotationManipulator::OnUpdate(Viewport &viewport) {
@@ -247,69 +298,19 @@ Manipulator *RotationManipulator::OnUpdate(Viewport &viewport) {
         const GfRotation worldRotation(_rotateFrom, rotateTo);
         const auto axisSign = _planeNormal3d * worldRotation.GetAxis() > 0 ? 1.0 : -1.0;
 
-        // Compute rotation axis in local coordinates
-        // We use the plane normal as the rotation between _rotateFrom and rotateTo might not land exactly on the rotation axis
-        const GfVec3d xAxis = _rotateMatrixOnBegin.GetRow3(0);
-        const GfVec3d yAxis = _rotateMatrixOnBegin.GetRow3(1);
-        const GfVec3d zAxis = _rotateMatrixOnBegin.GetRow3(2);
-
-        GfVec3d localPlaneNormal = xAxis; // default init
-        if (_selectedAxis == XAxis) {
-            localPlaneNormal = xAxis;
-        } else if (_selectedAxis == YAxis) {
-            localPlaneNormal = yAxis;
-        } else if (_selectedAxis == ZAxis) {
-            localPlaneNormal = zAxis;
-        }
-
-        const GfRotation deltaRotation(localPlaneNormal * axisSign, worldRotation.GetAngle());
-        // NOTE: should that be _rotateMatrixOnBegin * deltaRotation instead ? the formula for opTrans use this order
-        const GfMatrix4d resultingRotation = GfMatrix4d(1.0).SetRotate(deltaRotation) * _rotateMatrixOnBegin;
-
-        // Get latest rotation values to give a hint to the decompose function
-        GfVec3d translation;
-        GfVec3f rotation, scale, pivot;
-        UsdGeomXformCommonAPI::RotationOrder rotOrder;
-        _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale, &pivot, &rotOrder,
-                                                GetViewportTimeCode(viewport));
-        double thetaTw = GfDegreesToRadians(rotation[0]);
-        double thetaFB = GfDegreesToRadians(rotation[1]);
-        double thetaLR = GfDegreesToRadians(rotation[2]);
-        double thetaSw = 0.0;
-        // Decompose the matrix in angle values
-        GfRotation::DecomposeRotation(resultingRotation, xAxis, yAxis, zAxis, 1.0, &thetaTw, &thetaFB, &thetaLR, &thetaSw, true);
-        const GfVec3f newRotationValues =
-            GfVec3f(GfRadiansToDegrees(thetaTw), GfRadiansToDegrees(thetaFB), GfRadiansToDegrees(thetaLR));
-        if (_xformAPI) {
-            _xformAPI.SetRotate(newRotationValues, rotOrder, GetEditionTimeCode(viewport));
-        } else { // Modify only if we have a single matrix
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
-                // [ "xformOp:translate", "xformOp:translate:pivot", "xformOp:rotateXYZ",
-                // "xformOp:scale", "!invert!xformOp:translate:pivot" ] - No pivot here
-                GfMatrix4d current = GfMatrix4d().SetScale(scale) * _rotateMatrixOnBegin *
-                                     GfMatrix4d(1.0).SetRotate(deltaRotation) * GfMatrix4d().SetTranslate(translation);
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+        // All the prims rotate by the same angle around their own selected axis
+        const double angle = axisSign * worldRotation.GetAngle();
+        _editSession.SetValue(VtValue(angle), [this, angle]() {
+            for (size_t i = 0; i < _xformables.size() && i < _rotationsOnBegin.size(); ++i) {
+                SetRotation(i, angle);
             }
-        }
+        });
+        _editSession.Flush();
     }
 
     return this;
 };
 
-void RotationManipulator::OnEndEdition(Viewport &) { EndEdition(); }
-
-// TODO code should be shared with position manipulator
-UsdTimeCode RotationManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return GetViewportTimeCode(viewport);
-    }
-}
+void RotationManipulator::OnEndEdition(Viewport &) { _editSession.End(); }
 
 UsdTimeCode RotationManipulator::GetViewportTimeCode(const Viewport &viewport) { return viewport.GetCurrentTimeCode(); }
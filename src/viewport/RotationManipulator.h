@@ -31,19 +31,32 @@ class RotationManipulator : public Manipulator {
     void OnSelectionChange(Viewport &) override;
 
   private:
-    UsdTimeCode GetEditionTimeCode(const Viewport &);
     UsdTimeCode GetViewportTimeCode(const Viewport &);
 
     GfVec3d ComputeClockHandVector(Viewport &viewport);
 
     GfMatrix4d ComputeManipulatorToWorldTransform(const Viewport &viewport);
+
+    void SetRotation(size_t index, double angle);
+
     ManipulatorAxis _selectedAxis;
 
+    // Transformable prims of the selection, the first one places the manipulator
+    std::vector<UsdGeomXformable> _xformables;
     UsdGeomXformCommonAPI _xformAPI;
     UsdGeomXformable _xformable;
 
     GfVec3d _rotateFrom;
-    GfMatrix4d _rotateMatrixOnBegin;
+
+    // Transform values of a driven prim when the edition began, the rotation is updated with the authored values
+    struct PrimRotation {
+        GfMatrix4d matrixOnBegin;
+        GfVec3d translation;
+        GfVec3f rotation;
+        GfVec3f scale;
+        UsdGeomXformCommonAPI::RotationOrder rotOrder;
+    };
+    std::vector<PrimRotation> _rotationsOnBegin;
 
     GfVec3d _planeOrigin3d; // Global
     GfVec3d _planeNormal3d; // TODO rename global
@@ -51,4 +64,6 @@ class RotationManipulator : public Manipulator {
 
     std::vector<GfVec2d> _manipulatorCircles;
     std::vector<ImVec2> _manipulator2dPoints;
+
+    ManipulatorEditSession _editSession;
 };
@@ -20,9 +20,9 @@ ScaleManipulator::~ScaleManipulator() {}
 bool ScaleManipulator::IsMouseOver(const Viewport &viewport) {
 
     if (_xformable) {
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
-        const auto mv = frustum.ComputeViewMatrix();
-        const auto proj = frustum.ComputeProjectionMatrix();
+        const ViewportViewState &viewState = viewport.GetViewState();
+        const GfMatrix4d &mv = viewState.viewMatrix;
+        const GfMatrix4d &proj = viewState.projectionMatrix;
 
         const auto toWorld = ComputeManipulatorToWorldTransform(viewport);
 
@@ -63,10 +63,9 @@ bool ScaleManipulator::IsMouseOver(const Viewport &viewport) {
 
 // Same as rotation manipulator now -- TODO : share in a common class
 void ScaleManipulator::OnSelectionChange(Viewport &viewport) {
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(_xformAPI.GetPrim());
+    _xformables = GetSelectedXformables(viewport);
+    _xformable = _xformables.empty() ? UsdGeomXformable() : _xformables.front();
+    _xformAPI = UsdGeomXformCommonAPI(_xformable);
 }
 
 GfMatrix4d ScaleManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
@@ -79,7 +78,7 @@ GfMatrix4d ScaleManipulator::ComputeManipulatorToWorldTransform(const Viewport &
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot);
         const auto rotMat = _xformAPI.GetRotationTransform(rotation, rotOrder);
-        const auto parentToWorld = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorld = viewport.GetTransformCache().GetParentToWorldTransform(_xformable.GetPrim(), currentTime);
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = rotMat * pivotMat * transMat * parentToWorld;
@@ -100,9 +99,9 @@ template <int Axis> inline ImColor AxisColor(int selectedAxis) {
 void ScaleManipulator::OnDrawFrame(const Viewport &viewport) {
 
     if (_xformable) {
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
-        const auto mv = frustum.ComputeViewMatrix();
-        const auto proj = frustum.ComputeProjectionMatrix();
+        const ViewportViewState &viewState = viewport.GetViewState();
+        const GfMatrix4d &mv = viewState.viewMatrix;
+        const GfMatrix4d &proj = viewState.projectionMatrix;
 
         const auto toWorld = ComputeManipulatorToWorldTransform(viewport);
 
@@ -138,20 +137,45 @@ void ScaleManipulator::OnDrawFrame(const Viewport &viewport) {
     }
 }
 
+// Author the scale with the common api or in the single transform op of the prim
+static void SetScale(const UsdGeomXformable &xformable, const GfVec3f &scale, UsdTimeCode timeCode) {
+    UsdGeomXformCommonAPI xformAPI(xformable);
+    if (xformAPI) {
+        xformAPI.SetScale(scale, timeCode);
+    } else {
+        bool reset = false;
+        auto ops = xformable.GetOrderedXformOps(&reset);
+        if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
+            GfVec3d translation;
+            GfVec3f scale_, pivot, rotation;
+            UsdGeomXformCommonAPI::RotationOrder rotOrder;
+            xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale_, &pivot, &rotOrder, timeCode);
+            const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
+            const auto rotMat = xformAPI.GetRotationTransform(rotation, rotOrder);
+            GfMatrix4d current = GfMatrix4d().SetScale(scale) * rotMat * transMat;
+            ops[0].Set(current, timeCode);
+        }
+    }
+}
+
 void ScaleManipulator::OnBeginEdition(Viewport &viewport) {
-    // Save original translation values
-    GfVec3d translation;
-    GfVec3f pivot, rotation;
-    UsdGeomXformCommonAPI::RotationOrder rotOrder;
-    _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &_scaleOnBegin, &pivot, &rotOrder,
-                                            viewport.GetCurrentTimeCode());
+    // Save original scale values of all the driven prims
+    _scalesOnBegin.clear();
+    for (const UsdGeomXformable &xformable : _xformables) {
+        GfVec3d translation;
+        GfVec3f scale, pivot, rotation;
+        UsdGeomXformCommonAPI::RotationOrder rotOrder;
+        UsdGeomXformCommonAPI(xformable).GetXformVectorsByAccumulation(&translation, &rotation, &scale, &pivot, &rotOrder,
+                                                                       viewport.GetCurrentTimeCode());
+        _scalesOnBegin.push_back(scale);
+    }
 
     // Save mouse position on selected axis
     const GfMatrix4d objectTransform = ComputeManipulatorToWorldTransform(viewport);
     _axisLine = GfLine(objectTransform.ExtractTranslation(), objectTransform.GetRow3(_selectedAxis));
     ProjectMouseOnAxis(viewport, _originMouseOnAxis);
 
-    BeginEdition(viewport.GetCurrentStage());
+    _editSession.Begin(viewport.GetCurrentStage(), _xformables, viewport.GetCurrentTimeCode());
 }
 
 Manipulator *ScaleManipulator::OnUpdate(Viewport &viewport) {
@@ -171,41 +195,29 @@ Manipulator *ScaleManipulator::OnUpdate(Viewport &viewport) {
         _axisLine.FindClosestPoint(mouseOnAxis, &cur);
         double sign = cur > ori ? 1.0 : -1.0;
 
-        GfVec3f scale = _scaleOnBegin;
-
-        // TODO division per zero check
-        scale[_selectedAxis] = _scaleOnBegin[_selectedAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
+        if (_originMouseOnAxis.GetLength() == 0.0) {
+            return this;
+        }
+        const double ratio = mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
 
+        // All the prims are scaled by the same factors
+        GfVec3f factors(1.f);
         if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
-            scale[XAxis] = _scaleOnBegin[XAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-            scale[YAxis] = _scaleOnBegin[YAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-            scale[ZAxis] = _scaleOnBegin[XAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
+            factors = GfVec3f(ratio);
         } else {
-            scale[_selectedAxis] = _scaleOnBegin[_selectedAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
+            factors[_selectedAxis] = ratio;
         }
-
-        if (_xformAPI) {
-            _xformAPI.SetScale(scale, GetEditionTimeCode(viewport));
-        } else {
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
-                GfVec3d translation;
-                GfVec3f scale_, pivot, rotation;
-                UsdGeomXformCommonAPI::RotationOrder rotOrder;
-                _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale_, &pivot, &rotOrder,
-                                                        GetEditionTimeCode(viewport));
-                const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
-                const auto rotMat = _xformAPI.GetRotationTransform(rotation, rotOrder);
-                GfMatrix4d current = GfMatrix4d().SetScale(scale) * rotMat * transMat;
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+        _editSession.SetValue(VtValue(factors), [this, factors]() {
+            for (size_t i = 0; i < _xformables.size() && i < _scalesOnBegin.size(); ++i) {
+                SetScale(_xformables[i], GfCompMult(_scalesOnBegin[i], factors), _editSession.GetEditionTimeCode(i));
             }
-        }
+        });
+        _editSession.Flush();
     }
     return this;
 };
 
-void ScaleManipulator::OnEndEdition(Viewport &) { EndEdition(); };
+void ScaleManipulator::OnEndEdition(Viewport &) { _editSession.End(); };
 
 ///
 void ScaleManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &linePoint) {
@@ -213,19 +225,9 @@ void ScaleManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &lin
         GfVec3d rayPoint;
         double a = 0;
         double b = 0;
-        const auto &frustum = viewport.GetViewportCamera().GetFrustum();
+        const auto &frustum = viewport.GetViewState().frustum;
         const auto mouseRay = frustum.ComputeRay(viewport.GetMousePosition());
         GfFindClosestPoints(mouseRay, _axisLine, &rayPoint, &linePoint, &a, &b);
     }
 }
 
-UsdTimeCode ScaleManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return viewport.GetCurrentTimeCode();
-    }
-}
@@ -36,14 +36,16 @@ class ScaleManipulator : public Manipulator {
     void ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &closestPoint);
     GfMatrix4d ComputeManipulatorToWorldTransform(const Viewport &viewport);
 
-    UsdTimeCode GetEditionTimeCode(const Viewport &viewport);
-
     ManipulatorAxis _selectedAxis;
 
     GfVec3d _originMouseOnAxis;
-    GfVec3f _scaleOnBegin;
+    std::vector<GfVec3f> _scalesOnBegin;
     GfLine _axisLine;
 
+    // Transformable prims of the selection, the first one places the manipulator
+    std::vector<UsdGeomXformable> _xformables;
     UsdGeomXformCommonAPI _xformAPI;
     UsdGeomXformable _xformable;
+
+    ManipulatorEditSession _editSession;
 };
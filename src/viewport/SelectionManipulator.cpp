@@ -1,66 +1,109 @@
 #include <pxr/usd/kind/registry.h>
-#include <pxr/usd/usd/modelAPI.h>
 #include <pxr/usd/usd/prim.h>
+#include <algorithm>
+#include <set>
 #include "Viewport.h"
 #include "SelectionManipulator.h"
 #include "Gui.h"
 #include "Commands.h"
 
-bool SelectionManipulator::IsPickablePath(const UsdStage &stage, const SdfPath &path) {
-    auto prim = stage.GetPrimAtPath(path);
-    if (prim.IsPseudoRoot())
-        return true;
-    if (GetPickMode() == SelectionManipulator::PickMode::Prim)
-        return true;
-
-    TfToken primKind;
-    UsdModelAPI(prim).GetKind(&primKind);
-    if (GetPickMode() == SelectionManipulator::PickMode::Model && KindRegistry::GetInstance().IsA(primKind, KindTokens->model)) {
-        return true;
+// The model and assembly ancestors are cached, the kinds of the ancestors are not read again at each pick
+SdfPath SelectionManipulator::GetPickablePath(const UsdStageRefPtr &stage, const SdfPath &path) {
+    if (GetPickMode() == SelectionManipulator::PickMode::Model) {
+        return _modelHierarchy.GetClosestModelPath(stage, path, KindTokens->model);
     }
-    if (GetPickMode() == SelectionManipulator::PickMode::Assembly &&
-        KindRegistry::GetInstance().IsA(primKind, KindTokens->assembly)) {
-        return true;
+    if (GetPickMode() == SelectionManipulator::PickMode::Assembly) {
+        return _modelHierarchy.GetClosestModelPath(stage, path, KindTokens->assembly);
     }
-
     // Other possible tokens
     // KindTokens->component
     // KindTokens->group
     // KindTokens->subcomponent
 
     // We can also test for xformable or other schema API
+    return path;
+}
 
-    return false;
+void SelectionManipulator::OnBeginEdition(Viewport &viewport) {
+    _isDragging = false;
+    _dragStart = viewport.GetMousePosition();
+    _dragEnd = _dragStart;
 }
 
 Manipulator *SelectionManipulator::OnUpdate(Viewport &viewport) {
+    if (ImGui::IsMouseDown(0)) {
+        _isDragging = _isDragging || ImGui::IsMouseDragging(0);
+        _dragEnd = viewport.GetMousePosition();
+        return this;
+    }
+    if (_isDragging) {
+        SelectArea(viewport);
+    } else {
+        SelectPoint(viewport);
+    }
+    _isDragging = false;
+    return viewport.GetManipulator<MouseHoverManipulator>();
+}
+
+// The prims in the rectangle are found with one frustum query and selected with a single command
+void SelectionManipulator::SelectArea(Viewport &viewport) {
+    const UsdStageRefPtr &stage = viewport.GetCurrentStage();
+    if (!stage)
+        return;
+    SdfPathVector selectedPaths;
+    std::set<SdfPath> uniquePaths;
+    for (const SdfPath &hitPath : viewport.TestAreaIntersection(_dragStart, _dragEnd)) {
+        const SdfPath path = GetPickablePath(stage, hitPath);
+        if (!path.IsAbsoluteRootPath() && uniquePaths.insert(path).second) {
+            selectedPaths.push_back(path);
+        }
+    }
+    if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
+        if (!selectedPaths.empty()) {
+            ExecuteAfterDraw<EditorAddSelectedPaths>(stage, selectedPaths);
+        }
+    } else {
+        ExecuteAfterDraw<EditorSelectPaths>(stage, selectedPaths);
+    }
+}
+
+void SelectionManipulator::SelectPoint(Viewport &viewport) {
     Selection &selection = viewport.GetSelection();
-    auto mousePosition = viewport.GetMousePosition();
+    auto mousePosition = _dragStart;
     SdfPath outHitPrimPath;
     SdfPath outHitInstancerPath;
     int outHitInstanceIndex = 0;
     viewport.TestIntersection(mousePosition, outHitPrimPath, outHitInstancerPath, outHitInstanceIndex);
     if (!outHitPrimPath.IsEmpty()) {
         if (viewport.GetCurrentStage()) {
-            while (!IsPickablePath(*viewport.GetCurrentStage(), outHitPrimPath)) {
-                outHitPrimPath = outHitPrimPath.GetParentPath();
-            }
+            outHitPrimPath = GetPickablePath(viewport.GetCurrentStage(), outHitPrimPath);
         }
 
         if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
-            // TODO: a command
-            selection.AddSelected(viewport.GetCurrentStage(), outHitPrimPath);
+            ExecuteAfterDraw<EditorAddSelectedPaths>(viewport.GetCurrentStage(), SdfPathVector{outHitPrimPath});
         } else {
             ExecuteAfterDraw<EditorSetSelection>(viewport.GetCurrentStage(), outHitPrimPath);
         }
-    } else if (outHitInstancerPath.IsEmpty()) {
-        selection.Clear(viewport.GetCurrentStage());
+    } else if (outHitInstancerPath.IsEmpty() && !selection.IsSelectionEmpty(viewport.GetCurrentStage())) {
+        ExecuteAfterDraw<EditorSelectPaths>(viewport.GetCurrentStage(), SdfPathVector());
     }
-    return viewport.GetManipulator<MouseHoverManipulator>();
 }
 
 void SelectionManipulator::OnDrawFrame(const Viewport &) {
-    // Draw a rectangle for the selection
+    // Draw the selection rectangle, the hud window covers the viewport texture
+    if (_isDragging) {
+        ImDrawList *drawList = ImGui::GetWindowDrawList();
+        const ImVec2 textureSize = ImGui::GetMainViewport()->WorkSize;
+        const auto ToTextureScreenSpace = [&textureSize](const GfVec2d &position) {
+            return ImVec2((position[0] * 0.5 + 0.5) * textureSize.x, (-position[1] * 0.5 + 0.5) * textureSize.y);
+        };
+        const ImVec2 start = ToTextureScreenSpace(_dragStart);
+        const ImVec2 end = ToTextureScreenSpace(_dragEnd);
+        const ImVec2 rectMin(std::min(start.x, end.x), std::min(start.y, end.y));
+        const ImVec2 rectMax(std::max(start.x, end.x), std::max(start.y, end.y));
+        drawList->AddRectFilled(rectMin, rectMax, ImColor(ImVec4(1.0, 1.0, 1.0, 0.1)));
+        drawList->AddRect(rectMin, rectMax, ImColor(ImVec4(1.0, 1.0, 1.0, 0.8)));
+    }
 }
 
 void DrawPickMode(SelectionManipulator &manipulator) {
@@ -2,14 +2,19 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+#include <pxr/base/gf/vec2d.h>
 #include "Manipulator.h"
+#include "ModelHierarchyCache.h"
 
-/// The selection manipulator will help selecting a region of the viewport, drawing a rectangle.
+/// The selection manipulator selects the prim under the mouse on a click, or the prims in a rectangle drawn by
+/// dragging the mouse. The selection is applied when the mouse is released.
 class SelectionManipulator : public Manipulator {
   public:
     SelectionManipulator() = default;
     ~SelectionManipulator() = default;
 
+    void OnBeginEdition(Viewport &) override;
+
     void OnDrawFrame(const Viewport &) override;
 
     Manipulator *OnUpdate(Viewport &) override;
@@ -20,9 +25,19 @@ class SelectionManipulator : public Manipulator {
     PickMode GetPickMode() const { return _pickMode; }
 
   private:
-    // Returns true
-    bool IsPickablePath(const class UsdStage &stage, const class SdfPath &path);
+    // Returns the path or the closest ancestor which can be picked in the pick mode
+    SdfPath GetPickablePath(const UsdStageRefPtr &stage, const SdfPath &path);
+
+    void SelectPoint(Viewport &viewport);
+    void SelectArea(Viewport &viewport);
+
     PickMode _pickMode = PickMode::Prim;
+    ModelHierarchyCache _modelHierarchy;
+
+    // Rectangle selection, in normalized viewport coordinates
+    bool _isDragging = false;
+    GfVec2d _dragStart;
+    GfVec2d _dragEnd;
 };
 
 /// Draw an ImGui menu to select the picking mode
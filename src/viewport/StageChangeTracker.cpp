@@ -0,0 +1,24 @@
+#include "StageChangeTracker.h"
+
+StageChangeTracker::~StageChangeTracker() { TfNotice::Revoke(_objectsChangedKey); }
+
+bool StageChangeTracker::ConsumeChanges(const UsdStageRefPtr &stage) {
+    bool hasChanges = _hasChanges;
+    if (get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _stage = stage;
+        if (stage) {
+            _objectsChangedKey =
+                TfNotice::Register(TfCreateWeakPtr(this), &StageChangeTracker::OnObjectsChanged, UsdStageWeakPtr(stage));
+        }
+        hasChanges = true;
+    }
+    _hasChanges = false;
+    return hasChanges;
+}
+
+// Any change can modify the rendered image, the notice is not inspected
+void StageChangeTracker::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    _hasChanges = true;
+    _changeCount++;
+}
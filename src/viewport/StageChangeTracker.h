@@ -0,0 +1,38 @@
+#pragma once
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Records the changes of a stage between two frames of a viewport. The viewport renders again only when its stage,
+/// its camera, its time code or its selection have changed since the last rendered frame.
+///
+class StageChangeTracker : public TfWeakBase {
+  public:
+    StageChangeTracker() = default;
+    ~StageChangeTracker();
+
+    // Delete copy
+    StageChangeTracker(const StageChangeTracker &) = delete;
+    StageChangeTracker &operator=(const StageChangeTracker &) = delete;
+
+    /// Returns true if the stage is not the one of the last call or if it was changed since, and forgets the changes
+    bool ConsumeChanges(const UsdStageRefPtr &stage);
+
+    /// Returns true if the tracked stage was changed since the last call to ConsumeChanges
+    bool HasChanges() const { return _hasChanges; }
+
+    /// Number of change notices received, for debugging
+    size_t GetChangeCount() const { return _changeCount; }
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    bool _hasChanges = false;
+    size_t _changeCount = 0;
+};
@@ -0,0 +1,50 @@
+#include <pxr/usd/usdGeom/xformable.h>
+
+#include "TransformCache.h"
+
+TransformCache::TransformCache() : _cache(UsdTimeCode::Default()) {}
+
+TransformCache::~TransformCache() { TfNotice::Revoke(_objectsChangedKey); }
+
+UsdGeomXformCache &TransformCache::GetCache(const UsdPrim &prim, UsdTimeCode timeCode) {
+    const UsdStagePtr stage = prim.GetStage();
+    if (!_stage || get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _cache.Clear();
+        _stage = stage;
+        if (stage) {
+            _objectsChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &TransformCache::OnObjectsChanged, stage);
+        }
+    }
+    // SetTime keeps the transforms if the time code is the same
+    _cache.SetTime(timeCode);
+    return _cache;
+}
+
+// The manipulators write a transform attribute at each frame of an edition, which clears the cache once per frame.
+// The edits of the other attributes, the selection highlighting or the metadata don't clear it.
+void TransformCache::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    bool affectsTransforms = !notice.GetResyncedPaths().empty();
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        if (affectsTransforms)
+            break;
+        affectsTransforms = path.IsAbsoluteRootPath() ||
+                            (path.IsPropertyPath() && UsdGeomXformable::IsTransformationAffectedByAttrNamed(path.GetNameToken()));
+    }
+    if (affectsTransforms) {
+        _cache.Clear();
+        _invalidationCount++;
+    }
+}
+
+GfMatrix4d TransformCache::GetLocalToWorldTransform(const UsdPrim &prim, UsdTimeCode timeCode) {
+    return prim ? GetCache(prim, timeCode).GetLocalToWorldTransform(prim) : GfMatrix4d(1.0);
+}
+
+GfMatrix4d TransformCache::GetParentToWorldTransform(const UsdPrim &prim, UsdTimeCode timeCode) {
+    return prim ? GetCache(prim, timeCode).GetParentToWorldTransform(prim) : GfMatrix4d(1.0);
+}
+
+GfMatrix4d TransformCache::GetLocalTransformation(const UsdPrim &prim, UsdTimeCode timeCode, bool *resetsXformStack) {
+    return prim ? GetCache(prim, timeCode).GetLocalTransformation(prim, resetsXformStack) : GfMatrix4d(1.0);
+}
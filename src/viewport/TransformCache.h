@@ -0,0 +1,41 @@
+#pragma once
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/xformCache.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Transforms of the prims of a stage at a time code, owned by a viewport and shared by its manipulators.
+/// The transforms are computed on demand and kept until a transform attribute of the stage is changed or a prim is
+/// resynced, the other edits keep the cache.
+///
+class TransformCache : public TfWeakBase {
+  public:
+    TransformCache();
+    ~TransformCache();
+
+    // Delete copy
+    TransformCache(const TransformCache &) = delete;
+    TransformCache &operator=(const TransformCache &) = delete;
+
+    /// The cache is reset when the stage of the prim or the time code differ from the last call
+    GfMatrix4d GetLocalToWorldTransform(const UsdPrim &prim, UsdTimeCode timeCode);
+    GfMatrix4d GetParentToWorldTransform(const UsdPrim &prim, UsdTimeCode timeCode);
+    GfMatrix4d GetLocalTransformation(const UsdPrim &prim, UsdTimeCode timeCode, bool *resetsXformStack);
+
+    /// Number of times the cache was cleared by a stage change, for debugging
+    size_t GetInvalidationCount() const { return _invalidationCount; }
+
+  private:
+    UsdGeomXformCache &GetCache(const UsdPrim &prim, UsdTimeCode timeCode);
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    UsdGeomXformCache _cache;
+    size_t _invalidationCount = 0;
+};
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <pxr/imaging/garch/glApi.h>
@@ -14,6 +16,7 @@
 #include "Viewport.h"
 #include "Commands.h"
 #include "Constants.h"
+#include "FrameStatistics.h"
 #include "Shortcuts.h"
 #include "UsdPrimEditor.h" // DrawUsdPrimEditTarget
 
@@ -55,10 +58,10 @@ void Viewport::DrawMenuBar() {
     }
 }
 
-Viewport::Viewport(UsdStageRefPtr stage, Selection &selection)
+Viewport::Viewport(UsdStageRefPtr stage, Selection &selection, BoundingBoxCache &boundingBoxCache)
     : _stage(stage), _cameraManipulator({InitialWindowWidth, InitialWindowHeight}),
       _currentEditingState(new MouseHoverManipulator()), _activeManipulator(&_positionManipulator), _selection(selection),
-      _textureSize(1, 1), _viewportName("Viewport 1") {
+      _boundingBoxCache(boundingBoxCache), _textureSize(1, 1), _viewportName("Viewport 1") {
 
     // Viewport draw target
     _cameraManipulator.ResetPosition(GetEditableCamera());
@@ -70,6 +73,8 @@ Viewport::Viewport(UsdStageRefPtr stage, Selection &selection)
     auto color = _drawTarget->GetAttachment("color");
     _textureId = color->GetGlTextureName();
     _drawTarget->Unbind();
+
+    UpdateViewState();
 }
 
 Viewport::~Viewport() {
@@ -132,6 +137,13 @@ void Viewport::Draw() {
             ImGui::EndDisabled();
         }
     }
+    // The input on the viewport, its menus or its popups can move the camera, the manipulators or change the settings
+    if (!GImGui->InputEventsTrail.empty() &&
+        (ImGui::IsWindowHovered(ImGuiHoveredFlags_RootAndChildWindows) ||
+         ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) ||
+         ImGui::IsPopupOpen("", ImGuiPopupFlags_AnyPopupId | ImGuiPopupFlags_AnyPopupLevel))) {
+        _hasInputEvents = true;
+    }
 }
 
 void Viewport::DrawToolBar(const ImVec2 widgetPosition) {
@@ -260,12 +272,8 @@ void Viewport::DrawManipulatorToolbox(const ImVec2 widgetPosition) {
 /// Frame the viewport using the bounding box of the selection
 void Viewport::FrameCameraOnSelection(const Selection &selection) { // Camera manipulator ???
     if (GetCurrentStage() && !selection.IsSelectionEmpty(GetCurrentStage())) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
-        GfBBox3d bbox;
-        for (const auto &primPath : selection.GetSelectedPaths(GetCurrentStage())) {
-            bbox = GfBBox3d::Combine(bboxcache.ComputeWorldBound(GetCurrentStage()->GetPrimAtPath(primPath)), bbox);
-        }
-        auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
+        const GfBBox3d bbox = _boundingBoxCache.ComputeWorldBound(
+            GetCurrentStage(), selection.GetSelectedPaths(GetCurrentStage()), _imagingSettings.frame);
         _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bbox);
     }
 }
@@ -273,30 +281,16 @@ void Viewport::FrameCameraOnSelection(const Selection &selection) { // Camera ma
 /// Frame the viewport using the bounding box of the root prim
 void Viewport::FrameCameraOnRootPrim() {
     if (GetCurrentStage()) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
-        auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
-        if (defaultPrim) {
-            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bboxcache.ComputeWorldBound(defaultPrim));
-        } else {
-            auto rootPrim = GetCurrentStage()->GetPrimAtPath(SdfPath("/"));
-            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bboxcache.ComputeWorldBound(rootPrim));
-        }
+        _cameraManipulator.FrameBoundingBox(GetEditableCamera(),
+                                            _boundingBoxCache.ComputeStageBound(GetCurrentStage(), _imagingSettings.frame));
     }
 }
 
 void Viewport::FrameAllCameras() {
     if (GetCurrentStage()) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
-        auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
-        if (defaultPrim) {
-            for (GfCamera *camera: _cameras.GetEditableCameras(GetCurrentStage())) {
-                _cameraManipulator.FrameBoundingBox(*camera, bboxcache.ComputeWorldBound(defaultPrim));
-            }
-        } else {
-            for (GfCamera *camera: _cameras.GetEditableCameras(GetCurrentStage())) {
-                auto rootPrim = GetCurrentStage()->GetPrimAtPath(SdfPath("/"));
-                _cameraManipulator.FrameBoundingBox(*camera, bboxcache.ComputeWorldBound(rootPrim));
-            }
+        const GfBBox3d bbox = _boundingBoxCache.ComputeStageBound(GetCurrentStage(), _imagingSettings.frame);
+        for (GfCamera *camera : _cameras.GetEditableCameras(GetCurrentStage())) {
+            _cameraManipulator.FrameBoundingBox(*camera, bbox);
         }
     }
 }
@@ -311,8 +305,7 @@ GfVec2d Viewport::GetPickingBoundarySize() const {
 //
 double Viewport::ComputeScaleFactor(const GfVec3d &objectPos, const double multiplier) const {
     double scale = 1.0;
-    const auto &frustum = GetCurrentCamera().GetFrustum();
-    auto ray = frustum.ComputeRay(GfVec2d(0, 0)); // camera axis
+    auto ray = GetViewState().frustum.ComputeRay(GfVec2d(0, 0)); // camera axis
     ray.FindClosestPoint(objectPos, &scale);
     // TODO Ortho case: should the scale be based on the larger/smaller side ?
     if (GetCurrentCamera().GetProjection() == GfCamera::Orthographic) {
@@ -441,12 +434,26 @@ GfCamera Viewport::GetViewportCamera(double width, double height) const {
     return viewportCamera;
 }
 
-// TODO: keep the viewport camera in the structure and return a const ref
-GfCamera Viewport::GetViewportCamera() const {
-    GfVec2i renderSize = _drawTarget->GetSize();
-    const int width = renderSize[0];
-    const int height = renderSize[1];
-    return GetViewportCamera(width, height);
+static ViewStateStatistics viewStateStatistics;
+
+const ViewStateStatistics &GetViewStateStatistics() { return viewStateStatistics; }
+
+const ViewportViewState &Viewport::GetViewState() const {
+    viewStateStatistics.readCount++;
+    return _viewState;
+}
+
+void Viewport::UpdateViewState() {
+    const auto start = clk::steady_clock::now();
+    const GfVec2i renderSize = _drawTarget->GetSize();
+    _viewState.camera = GetViewportCamera(renderSize[0], renderSize[1]);
+    _viewState.frustum = _viewState.camera.GetFrustum();
+    _viewState.viewMatrix = _viewState.frustum.ComputeViewMatrix();
+    _viewState.projectionMatrix = _viewState.frustum.ComputeProjectionMatrix();
+    _viewState.inverseViewMatrix = _viewState.viewMatrix.GetInverse();
+    viewStateStatistics.computeCount++;
+    viewStateStatistics.computeMilliseconds +=
+        clk::duration<double, std::milli>(clk::steady_clock::now() - start).count();
 }
 
 void Viewport::BeginHydraUI(int width, int height) {
@@ -483,10 +490,25 @@ void Viewport::Render() {
     if (width == 0 || height == 0)
         return;
 
+    if (!_needsRender) {
+        GetFrameStatistics().skippedViewportFrames++;
+        return;
+    }
+    _needsRender = false;
+    _hasInputEvents = false;
+    _renderedViewMatrix = _viewState.viewMatrix;
+    _renderedProjectionMatrix = _viewState.projectionMatrix;
+    _renderedTimeCode = GetCurrentTimeCode();
+    GetFrameStatistics().renderedViewportFrames++;
+
     // Draw active manipulator and HUD
     if (_imagingSettings.showGizmos) {
         BeginHydraUI(width, height);
         GetActiveManipulator().OnDrawFrame(*this);
+        // The selection rectangle is drawn while dragging, whichever manipulator is active
+        if (_currentEditingState == GetManipulator<SelectionManipulator>() && _currentEditingState != &GetActiveManipulator()) {
+            _currentEditingState->OnDrawFrame(*this);
+        }
         // DrawHUD(this);
         EndHydraUI();
     }
@@ -531,9 +553,8 @@ void Viewport::Render() {
  //       if (_cameras.IsUsingStageCamera()) {
 //            _renderer->SetCameraPath(_cameras.GetStageCameraPath());
 //        } else {
-            const GfCamera viewportCamera = GetViewportCamera(width, height);
-            _renderer->SetCameraState(viewportCamera.GetFrustum().ComputeViewMatrix(),
-                                      viewportCamera.GetFrustum().ComputeProjectionMatrix());
+            const ViewportViewState &viewState = GetViewState();
+            _renderer->SetCameraState(viewState.viewMatrix, viewState.projectionMatrix);
   //      }
         _renderer->Render(GetCurrentStage()->GetPseudoRoot(), _imagingSettings);
     } else {
@@ -558,6 +579,7 @@ void Viewport::SetCurrentTimeCode(const UsdTimeCode &tc) {
 
 /// Update anything that could have change after a frame render
 void Viewport::Update() {
+    bool stageHasChanged = false;
     if (GetCurrentStage()) {
         bool firstTimeStageLoaded = false;
         auto whichRenderer = _renderers.find(GetCurrentStage()); /// We expect a very limited number of opened stages
@@ -574,8 +596,9 @@ void Viewport::Update() {
             _cameraManipulator.SetZIsUp(UsdGeomGetStageUpAxis(GetCurrentStage()) == "Z");
             // TODO: should reset the camera otherwise, depending on the position of the camera, the transform is incorrect
             _grid.SetZIsUp(UsdGeomGetStageUpAxis(GetCurrentStage()) == "Z");
-            // TODO: the selection is also different per stage
-            //_selection =
+            // The selection is kept per stage and the renderer of the stage still highlights it, only the manipulators
+            // have to follow the selection of the new stage
+            stageHasChanged = true;
         }
 
         // Update cameras state, this will assign the user selected camera for the current stage at
@@ -597,35 +620,87 @@ void Viewport::Update() {
     }
 
     const GfVec2i &currentSize = _drawTarget->GetSize();
-    if (currentSize != _textureSize) {
+    const bool sizeHasChanged = currentSize != _textureSize;
+    if (sizeHasChanged) {
         _drawTarget->Bind();
         _drawTarget->SetSize(_textureSize);
         _drawTarget->Unbind();
     }
 
-    if (_renderer && _selection.UpdateSelectionHash(GetCurrentStage(), _lastSelectionHash)) {
+    const bool selectionHasChanged =
+        _renderer && _selection.UpdateSelectionHash(GetCurrentStage(), _lastSelectionHashes[GetCurrentStage()]);
+    if (selectionHasChanged) {
         _renderer->ClearSelected();
         _renderer->SetSelected(_selection.GetSelectedPaths(GetCurrentStage()));
-
+    }
+    if (selectionHasChanged || stageHasChanged) {
         // Tell the manipulators the selection has changed
         _positionManipulator.OnSelectionChange(*this);
         _rotationManipulator.OnSelectionChange(*this);
         _scaleManipulator.OnSelectionChange(*this);
     }
+
+    // The cameras and the render size won't change until the next frame
+    UpdateViewState();
+
+    // A progressive renderer is rendered until it converges
+    const bool stageWasEdited = _stageChanges.ConsumeChanges(GetCurrentStage());
+    _needsRender = _needsRender || _hasInputEvents || stageWasEdited || stageHasChanged || selectionHasChanged ||
+                   sizeHasChanged || _renderedTimeCode != GetCurrentTimeCode() ||
+                   _renderedViewMatrix != _viewState.viewMatrix || _renderedProjectionMatrix != _viewState.projectionMatrix ||
+                   (_renderer && !_renderer->IsConverged());
+}
+
+bool Viewport::NeedsRender() const {
+    return _needsRender || _hasInputEvents || _stageChanges.HasChanges() || (_renderer && !_renderer->IsConverged());
 }
 
 
+// Purposes drawn by the renderer, the prims with the other purposes can't be picked
+static TfTokenVector GetDrawnPurposes(const ImagingSettings &imagingSettings) {
+    TfTokenVector purposes = {UsdGeomTokens->default_};
+    if (imagingSettings.showGuides)
+        purposes.push_back(UsdGeomTokens->guide);
+    if (imagingSettings.showProxy)
+        purposes.push_back(UsdGeomTokens->proxy);
+    if (imagingSettings.showRender)
+        purposes.push_back(UsdGeomTokens->render);
+    return purposes;
+}
+
+void Viewport::UpdatePickingHierarchy() {
+    _pickingHierarchy.Update(GetCurrentStage(), GetCurrentTimeCode(), GetDrawnPurposes(_imagingSettings), _boundingBoxCache);
+}
+
+// The rectangle is always resolved on the cpu, an id render would have to read back all the pixels of the area
+SdfPathVector Viewport::TestAreaIntersection(GfVec2d corner, GfVec2d oppositeCorner) {
+    if (!GetCurrentStage())
+        return {};
+    UpdatePickingHierarchy();
+    // The narrowed frustum is centered on the rectangle, its size is relative to the [-1, 1] window
+    const GfVec2d center = (corner + oppositeCorner) * 0.5;
+    const GfVec2d size(std::max(fabs(oppositeCorner[0] - corner[0]) * 0.5, 1e-6),
+                       std::max(fabs(oppositeCorner[1] - corner[1]) * 0.5, 1e-6));
+    return _pickingHierarchy.IntersectFrustum(GetViewState().frustum.ComputeNarrowedFrustum(center, size));
+}
+
 bool Viewport::TestIntersection(GfVec2d clickedPoint, SdfPath &outHitPrimPath, SdfPath &outHitInstancerPath, int &outHitInstanceIndex) {
 
     GfVec2i renderSize = _drawTarget->GetSize();
     double width = static_cast<double>(renderSize[0]);
     double height = static_cast<double>(renderSize[1]);
 
-    GfCamera viewportCamera = GetViewportCamera(width, height);
-    GfFrustum pixelFrustum = viewportCamera.GetFrustum().ComputeNarrowedFrustum(clickedPoint, GfVec2d(1.0 / width, 1.0 / height));
+    const ViewportViewState &viewState = GetViewState();
+    if (_imagingSettings.pickingBackend == ImagingSettings::BvhPicking) {
+        if (!GetCurrentStage())
+            return false;
+        UpdatePickingHierarchy();
+        return _pickingHierarchy.IntersectRay(viewState.frustum.ComputePickRay(clickedPoint), outHitPrimPath);
+    }
+    GfFrustum pixelFrustum = viewState.frustum.ComputeNarrowedFrustum(clickedPoint, GfVec2d(1.0 / width, 1.0 / height));
     GfVec3d outHitPoint;
     GfVec3d outHitNormal;
-    return (_renderer && GetCurrentStage() && _renderer->TestIntersection(viewportCamera.GetFrustum().ComputeViewMatrix(),
+    return (_renderer && GetCurrentStage() && _renderer->TestIntersection(viewState.viewMatrix,
             pixelFrustum.ComputeProjectionMatrix(),
             GetCurrentStage()->GetPseudoRoot(), _imagingSettings, &outHitPoint, &outHitNormal,
             &outHitPrimPath, &outHitInstancerPath, &outHitInstanceIndex));
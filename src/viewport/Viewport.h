@@ -6,16 +6,21 @@
 ///
 #include <map>
 #include <chrono>
+#include "BoundingBoxCache.h"
+#include "BoundingVolumeHierarchy.h"
 #include "Manipulator.h"
 #include "CameraManipulator.h"
 #include "PositionManipulator.h"
 #include "MouseHoverManipulator.h"
 #include "SelectionManipulator.h"
+#include "StageChangeTracker.h"
 #include "RotationManipulator.h"
 #include "ScaleManipulator.h"
+#include "TransformCache.h"
 #include "Selection.h"
 #include "Grid.h"
 #include "ViewportCameras.h"
+#include "ViewportViewState.h"
 #include <pxr/imaging/glf/drawTarget.h>
 #include <pxr/usd/usd/stage.h>
 #include <pxr/usdImaging/usdImagingGL/engine.h>
@@ -24,19 +29,22 @@
 
 class Viewport final {
   public:
-    Viewport(UsdStageRefPtr stage, Selection &);
+    Viewport(UsdStageRefPtr stage, Selection &, BoundingBoxCache &);
     ~Viewport();
 
     // Delete copy
     Viewport(const Viewport &) = delete;
     Viewport &operator=(const Viewport &) = delete;
 
-    /// Render hydra image on a texture
+    /// Render hydra image on a texture, the previous image is kept when none of the inputs of the frame has changed
     void Render();
 
     /// Update internal data: selection, current renderer
     void Update();
 
+    /// Returns true if the next frame has to be rendered, the main loop doesn't wait for events until it is rendered
+    bool NeedsRender() const;
+
     /// Draw the full viewport widget
     void Draw();
 
@@ -61,8 +69,11 @@ class Viewport final {
     /// Return the camera selected by the user.
     const GfCamera &GetCurrentCamera() const;
     
-    /// Return the camera used to render the viewport. TODO make it const &
-    GfCamera GetViewportCamera() const;
+    /// Return the camera used to render the viewport
+    const GfCamera &GetViewportCamera() const { return GetViewState().camera; }
+
+    /// Return the camera, frustum and matrices used to render the viewport, computed in Update
+    const ViewportViewState &GetViewState() const;
     
     /// Returns the path of the selected stage camera or SdfPath() if the camera is internal
     inline const SdfPath &GetSelectedStageCameraPath () { return _cameras.GetStageCameraPath(); }
@@ -75,6 +86,8 @@ class Viewport final {
 
     // Picking
     bool TestIntersection(GfVec2d clickedPoint, SdfPath &outHitPrimPath, SdfPath &outHitInstancerPath, int &outHitInstanceIndex);
+    /// Returns the prims intersecting the rectangle between the corners, with the bounding volume hierarchy
+    SdfPathVector TestAreaIntersection(GfVec2d corner, GfVec2d oppositeCorner);
     GfVec2d GetPickingBoundarySize() const;
 
     // Utility function for compute a scale for the manipulators. It uses the distance between the camera
@@ -115,6 +128,12 @@ class Viewport final {
 
     Selection &GetSelection() { return _selection; }
 
+    /// World bounds of the prims, shared by the viewports
+    BoundingBoxCache &GetBoundingBoxCache() { return _boundingBoxCache; }
+
+    /// Transforms of the prims at the time code of this viewport, used by the manipulators
+    TransformCache &GetTransformCache() const { return _transformCache; }
+
     /// Handle events is implemented as a finite state machine.
     /// The state are simply the current manipulator used.
     void HandleManipulationEvents();
@@ -125,6 +144,21 @@ class Viewport final {
     
     /// Returns the current camera updated to match the viewport ratio
     GfCamera GetViewportCamera(double width, double height) const;
+
+    /// Compute the view state of the frame from the current camera and the render size
+    void UpdateViewState();
+    ViewportViewState _viewState;
+
+    /// Build or refit the bounding volume hierarchy used for picking on the cpu
+    void UpdatePickingHierarchy();
+
+    /// Inputs of the last rendered frame, the viewport is rendered again only when one of them has changed
+    StageChangeTracker _stageChanges;
+    GfMatrix4d _renderedViewMatrix;
+    GfMatrix4d _renderedProjectionMatrix;
+    UsdTimeCode _renderedTimeCode;
+    bool _hasInputEvents = false; // The user interacted with the viewport window or one of its popups
+    bool _needsRender = true;
     
     // Viewport ID
     std::string _viewportName;
@@ -144,7 +178,10 @@ class Viewport final {
     SelectionManipulator _selectionManipulator;
 
     Selection &_selection;
-    SelectionHash _lastSelectionHash = 0;
+    BoundingBoxCache &_boundingBoxCache;
+    mutable TransformCache _transformCache;
+    BoundingVolumeHierarchy _pickingHierarchy; // Cpu picking, built on the first pick
+    std::map<UsdStageRefPtr, SelectionHash> _lastSelectionHashes; // Last selection highlighted by the renderer of each stage
 
     // Hydra canvas
     void BeginHydraUI(int width, int height);
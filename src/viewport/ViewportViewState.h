@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <pxr/base/gf/camera.h>
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/matrix4d.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Camera of a viewport with its frustum and matrices. It is computed once per frame when the viewport is updated,
+/// the renderer, the grid, the manipulators and the picking read it instead of computing the frustum again.
+///
+struct ViewportViewState {
+    GfCamera camera; // Current camera matching the viewport ratio
+    GfFrustum frustum;
+    GfMatrix4d viewMatrix;
+    GfMatrix4d projectionMatrix;
+    GfMatrix4d inverseViewMatrix;
+};
+
+/// Number of view states computed and read by all the viewports, for debugging. Each read used to compute the camera,
+/// its frustum and its matrices.
+struct ViewStateStatistics {
+    size_t computeCount = 0;
+    size_t readCount = 0;
+    double computeMilliseconds = 0.0;
+};
+
+const ViewStateStatistics &GetViewStateStatistics();
@@ -1,3 +1,4 @@
+#include "ArrayEdit.h"
 #include "Commands.h"
 #include "Gui.h"
 #include "VtValueEditor.h"
@@ -274,24 +275,33 @@ static void DrawSamplesAtTimeCode(const SdfAttributeSpecHandle &attr, SdfTimeSam
     if (selectedKeyframe == UsdTimeCode::Default()) {
         if (attr->HasDefaultValue()) {
             VtValue value = attr->GetDefaultValue();
-            VtValue editedValue = value.IsArrayValued() ? DrawVtArrayValue(value) : DrawVtValue("##default", value);
-            if (editedValue != VtValue()) {
-                ExecuteAfterDraw(&SdfAttributeSpec::SetDefaultValue, attr, editedValue);
+            if (value.IsArrayValued()) {
+                ArrayEdit edit;
+                if (DrawVtArrayValue(value, edit)) {
+                    ExecuteAfterDraw<AttributeEditArray>(attr->GetLayer(), attr->GetPath(), UsdTimeCode::Default(), edit);
+                }
+            } else {
+                VtValue editedValue = DrawVtValue("##default", value);
+                if (editedValue != VtValue()) {
+                    ExecuteAfterDraw(&SdfAttributeSpec::SetDefaultValue, attr, editedValue);
+                }
             }
         }
     } else {
         auto foundSample = timeSamples.find(selectedKeyframe.GetValue());
         if (foundSample != timeSamples.end()) {
-            VtValue editResult;
             if (foundSample->second.IsArrayValued()) {
-                editResult = DrawVtArrayValue(foundSample->second);
+                ArrayEdit edit;
+                if (DrawVtArrayValue(foundSample->second, edit)) {
+                    ExecuteAfterDraw<AttributeEditArray>(attr->GetLayer(), attr->GetPath(), UsdTimeCode(foundSample->first),
+                                                         edit);
+                }
             } else {
-                editResult = DrawVtValue("##timeSampleValue", foundSample->second);
-            }
-
-            if (editResult != VtValue()) {
-                ExecuteAfterDraw(&SdfLayer::SetTimeSample<VtValue>, attr->GetLayer(), attr->GetPath(), foundSample->first,
-                                 editResult);
+                VtValue editResult = DrawVtValue("##timeSampleValue", foundSample->second);
+                if (editResult != VtValue()) {
+                    ExecuteAfterDraw(&SdfLayer::SetTimeSample<VtValue>, attr->GetLayer(), attr->GetPath(), foundSample->first,
+                                     editResult);
+                }
             }
         }
     }
@@ -1,8 +1,15 @@
+#include <algorithm>
 #include <iostream>
 
+#include <map>
+#include <unordered_map>
 #include <vector>
 
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/base/trace/trace.h>
 #include <pxr/usd/pcp/layerStack.h>
+#include <pxr/usd/usd/notice.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdGeom/gprim.h>
 
@@ -10,6 +17,7 @@
 #include "Constants.h"
 #include "Gui.h"
 #include "ImGuiHelpers.h"
+#include "PrimQuery.h"
 #include "UsdPrimEditor.h" // for DrawUsdPrimEditTarget
 #include "StageOutliner.h"
 #include "VtValueEditor.h"
@@ -139,22 +147,69 @@ static void DrawUsdPrimEditMenuItems(const UsdPrim &prim) {
     }
 }
 
-static ImVec4 GetPrimColor(const UsdPrim &prim) {
-    if (!prim.IsActive() || !prim.IsLoaded()) {
+/// Display information of a prim, cached between frames to avoid querying the composition for every visible row
+struct StageOutlinerPrimInfo {
+    enum Flags : uint8_t {
+        IsActive = 1 << 0,
+        IsLoaded = 1 << 1,
+        IsDefined = 1 << 2,
+        IsInstance = 1 << 3,
+        IsPrototypeOrProxy = 1 << 4,
+        HasCompositionArcs = 1 << 5,
+        IsImageable = 1 << 6,
+        HasAuthoredVisibility = 1 << 7,
+    };
+
+    explicit StageOutlinerPrimInfo(const UsdPrim &prim);
+
+    inline bool Has(Flags flag) const { return (flags & flag) != 0; }
+
+    uint8_t flags = 0;
+    TfToken typeName;
+    TfToken visibility;
+};
+
+StageOutlinerPrimInfo::StageOutlinerPrimInfo(const UsdPrim &prim) {
+    if (!prim)
+        return;
+    typeName = prim.GetTypeName();
+    flags |= prim.IsActive() ? IsActive : 0;
+    flags |= prim.IsLoaded() ? IsLoaded : 0;
+    flags |= prim.IsDefined() ? IsDefined : 0;
+    flags |= prim.IsInstance() ? IsInstance : 0;
+    flags |= (prim.IsPrototype() || prim.IsInPrototype() || prim.IsInstanceProxy()) ? IsPrototypeOrProxy : 0;
+    const auto hasCompositionArcs = prim.HasAuthoredReferences() || prim.HasAuthoredPayloads() || prim.HasAuthoredInherits() ||
+                                    prim.HasAuthoredSpecializes() || prim.HasVariantSets();
+    flags |= hasCompositionArcs ? HasCompositionArcs : 0;
+    // TODO: this should work with animation
+    UsdGeomImageable imageable(prim);
+    if (imageable) {
+        flags |= IsImageable;
+        auto attr = imageable.GetVisibilityAttr();
+        VtValue visibleValue;
+        attr.Get(&visibleValue);
+        if (visibleValue.IsHolding<TfToken>()) {
+            visibility = visibleValue.UncheckedGet<TfToken>();
+        }
+        flags |= attr.HasAuthoredValue() ? HasAuthoredVisibility : 0;
+    }
+}
+
+static ImVec4 GetPrimColor(const StageOutlinerPrimInfo &primInfo) {
+    using Info = StageOutlinerPrimInfo;
+    if (!primInfo.Has(Info::IsActive) || !primInfo.Has(Info::IsLoaded)) {
         return ImVec4(ColorPrimInactive);
     }
-    if (prim.IsInstance()) {
+    if (primInfo.Has(Info::IsInstance)) {
         return ImVec4(ColorPrimInstance);
     }
-    const auto hasCompositionArcs = prim.HasAuthoredReferences() || prim.HasAuthoredPayloads() || prim.HasAuthoredInherits() ||
-                                    prim.HasAuthoredSpecializes() || prim.HasVariantSets();
-    if (hasCompositionArcs) {
+    if (primInfo.Has(Info::HasCompositionArcs)) {
         return ImVec4(ColorPrimHasComposition);
     }
-    if (prim.IsPrototype() || prim.IsInPrototype() || prim.IsInstanceProxy()) {
+    if (primInfo.Has(Info::IsPrototypeOrProxy)) {
         return ImVec4(ColorPrimPrototype);
     }
-    if (!prim.IsDefined()) {
+    if (!primInfo.Has(Info::IsDefined)) {
         return ImVec4(ColorPrimUndefined);
     }
     return ImVec4(ColorPrimDefault);
@@ -171,34 +226,56 @@ static inline const char *GetVisibilityIcon(const TfToken &visibility) {
     return ICON_FA_EYE;
 }
 
-static void DrawVisibilityButton(const UsdPrim &prim) {
-    // TODO: this should work with animation
-    UsdGeomImageable imageable(prim);
-    if (imageable) {
-        ImGui::PushID(IdOf(prim.GetPath().GetHash()));
-        // Get visibility value
-        auto attr = imageable.GetVisibilityAttr();
-        VtValue visibleValue;
-        attr.Get(&visibleValue);
-        TfToken visibilityToken = visibleValue.Get<TfToken>();
-        const char *visibilityIcon = GetVisibilityIcon(visibilityToken);
+// The visibility edit applies to all the selected prims when the row is selected
+static std::vector<UsdGeomImageable> GetEditedImageables(const UsdStageRefPtr &stage, const SdfPath &path, const Selection &selectedPaths,
+                                                         bool selected) {
+    std::vector<UsdGeomImageable> imageables;
+    if (selected) {
+        for (const SdfPath &selectedPath : selectedPaths.GetSelectedPaths(stage)) {
+            if (const UsdGeomImageable imageable = UsdGeomImageable(stage->GetPrimAtPath(selectedPath))) {
+                imageables.push_back(imageable);
+            }
+        }
+    } else {
+        imageables.emplace_back(stage->GetPrimAtPath(path));
+    }
+    return imageables;
+}
+
+static void DrawVisibilityButton(const UsdStageRefPtr &stage, const SdfPath &path, const StageOutlinerPrimInfo &primInfo,
+                                 const Selection &selectedPaths, bool selected) {
+    if (primInfo.Has(StageOutlinerPrimInfo::IsImageable)) {
+        ImGui::PushID(IdOf(path.GetHash()));
+        const bool hasAuthoredValue = primInfo.Has(StageOutlinerPrimInfo::HasAuthoredVisibility);
+        const char *visibilityIcon = GetVisibilityIcon(primInfo.visibility);
         {
-            ScopedStyleColor buttonColor(
-                ImGuiCol_Text, attr.HasAuthoredValue() ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
+            ScopedStyleColor buttonColor(ImGuiCol_Text, hasAuthoredValue ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
             ImGui::SmallButton(visibilityIcon);
             // Menu to select the new visibility
             {
                 ScopedStyleColor menuTextColor(ImGuiCol_Text, ImVec4(1.0, 1.0, 1.0, 1.0));
                 if (ImGui::BeginPopupContextItem(nullptr, ImGuiPopupFlags_MouseButtonLeft)) {
-                    if (attr.HasAuthoredValue() && ImGui::MenuItem("clear visibiliy")) {
-                        ExecuteAfterDraw(&UsdPrim::RemoveProperty, prim, attr.GetName());
+                    // The attribute is only queried when the menu is opened
+                    const UsdPrim prim = stage->GetPrimAtPath(path);
+                    auto attr = UsdGeomImageable(prim).GetVisibilityAttr();
+                    if (hasAuthoredValue && ImGui::MenuItem("clear visibiliy")) {
+                        BeginCommandBatch();
+                        for (const UsdGeomImageable &imageable : GetEditedImageables(stage, path, selectedPaths, selected)) {
+                            ExecuteAfterDraw(&UsdPrim::RemoveProperty, imageable.GetPrim(), attr.GetName());
+                        }
+                        EndCommandBatch();
                     }
                     VtValue allowedTokens;
                     attr.GetMetadata(TfToken("allowedTokens"), &allowedTokens);
                     if (allowedTokens.IsHolding<VtArray<TfToken>>()) {
                         for (const auto &token : allowedTokens.Get<VtArray<TfToken>>()) {
                             if (ImGui::MenuItem(token.GetText())) {
-                                ExecuteAfterDraw<AttributeSet>(attr, VtValue(token), UsdTimeCode::Default());
+                                BeginCommandBatch();
+                                for (const UsdGeomImageable &imageable : GetEditedImageables(stage, path, selectedPaths, selected)) {
+                                    ExecuteAfterDraw<AttributeSet>(imageable.GetVisibilityAttr(), VtValue(token),
+                                                                   UsdTimeCode::Default());
+                                }
+                                EndCommandBatch();
                             }
                         }
                     }
@@ -211,84 +288,360 @@ static void DrawVisibilityButton(const UsdPrim &prim) {
 }
 
 // This is pretty similar to DrawBackgroundSelection in the SdfLayerSceneGraphEditor
-static void DrawBackgroundSelection(const UsdPrim &prim, bool selected) {
+// A partially selected row is a folded row with selected descendants
+static void DrawBackgroundSelection(bool selected, bool partiallySelected) {
 
     ImVec4 colorSelected = selected ? ImVec4(ColorPrimSelectedBg) : ImVec4(0.75, 0.60, 0.33, 0.2);
     ScopedStyleColor scopedStyle(ImGuiCol_HeaderHovered, selected ? colorSelected : ImVec4(ColorTransparent),
                                  ImGuiCol_HeaderActive, ImVec4(ColorTransparent), ImGuiCol_Header, colorSelected);
     ImVec2 sizeArg(0.0, TableRowDefaultHeight);
     const auto selectableFlags = ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap;
-    ImGui::Selectable("##backgroundSelectedPrim", selected, selectableFlags, sizeArg);
+    ImGui::Selectable("##backgroundSelectedPrim", selected || partiallySelected, selectableFlags, sizeArg);
     ImGui::SetItemAllowOverlap();
     ImGui::SameLine();
 }
 
 
 
-static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, StageOutlinerDisplayOptions &displayOptions) {
+/// A row of the outliner, the path of the prim and whether it has children to unfold
+struct StageOutlinerRow {
+    StageOutlinerRow(const SdfPath &path_, bool hasChildren_) : path(path_), hasChildren(hasChildren_) {}
+    SdfPath path;
+    bool hasChildren;
+};
+
+static inline bool IsOpenedInTree(ImGuiStorage *storage, const SdfPath &path) {
+    return storage->GetInt(IdOf(GetHash(path)), 0) != 0;
+}
+
+static void TraverseRange(UsdPrimRange &range, const Usd_PrimFlagsPredicate &predicate, std::vector<StageOutlinerRow> &rows) {
+    static std::set<SdfPath> retainedPath; // to fix a bug with instanced prim which recreates the path at every call and give a different hash
+    ImGuiContext &g = *GImGui;
+    ImGuiWindow *window = g.CurrentWindow;
+    ImGuiStorage *storage = window->DC.StateStorage;
+    for (auto iter = range.begin(); iter != range.end(); ++iter) {
+        const auto &path = iter->GetPath();
+        const bool hasChildren = !iter->GetFilteredChildren(predicate).empty();
+        if (!hasChildren || !IsOpenedInTree(storage, path)) {
+            iter.PruneChildren();
+        }
+        // This bit of code is to avoid a bug. It appears that the SdfPath of instance proxies are not kept and the underlying memory
+        // is deleted and recreated between each frame, invalidating the hash value. So for the same path we have different hash every frame :s not cool.
+        // This problems appears on versions > 21.11
+        // a look at the changelog shows that they were lots of changes on the SdfPath side:
+        // https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
+        //
+        // In the end we workaround this issue by keeping the instance proxy paths alive:
+        if (iter->IsInstanceProxy()) {
+            retainedPath.insert(path);
+        }
+        rows.emplace_back(path, hasChildren);
+    }
+}
+
+/// Flattened list of the rows displayed by the outliner.
+/// It is kept between frames and updated only when the stage is resynced or when a tree node is opened or closed,
+/// a frame without any changes doesn't traverse the stage.
+class StageOutlinerRows : public TfWeakBase {
+  public:
+    ~StageOutlinerRows() { TfNotice::Revoke(_objectsChangedKey); }
+
+    /// Update the rows, this must be called inside the table scope to get the correct treenode hash table
+    void Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions);
+
+    /// All the rows will be recomputed at the next update
+    void Invalidate() { _mustRebuildAll = true; }
+
+    /// The rows under path will be recomputed at the next update
+    void InvalidateDescendants(const SdfPath &path) { _invalidatedPaths.push_back(path); }
+
+    const std::vector<StageOutlinerRow> &GetRows() const { return _rows; }
+
+    /// Returns the display information of the prim at path, computed only if it is not already in the cache
+    const StageOutlinerPrimInfo &GetPrimInfo(const SdfPath &path);
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+
+    void RebuildAll(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions);
+    void RebuildDescendants(size_t rowIndex, const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions);
+    void IndexRows();
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    std::vector<StageOutlinerRow> _rows;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _rowIndices; // Row index of the displayed paths
+    SdfPathVector _invalidatedPaths;
+    bool _mustRebuildAll = true;
+
+    // Display information of the rows drawn so far, ordered so the infos under a resynced path are a contiguous range
+    std::map<SdfPath, StageOutlinerPrimInfo> _primInfos;
+};
+
+const StageOutlinerPrimInfo &StageOutlinerRows::GetPrimInfo(const SdfPath &path) {
+    auto found = _primInfos.find(path);
+    if (found == _primInfos.end()) {
+        found = _primInfos.emplace(path, StageOutlinerPrimInfo(_stage->GetPrimAtPath(path))).first;
+    }
+    return found->second;
+}
+
+void StageOutlinerRows::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    // Only the resynced prims can add or remove rows, the property changes are ignored
+    const auto resyncedPaths = notice.GetResyncedPaths();
+    for (const SdfPath &path : resyncedPaths) {
+        if (path.IsAbsoluteRootPath()) {
+            Invalidate();
+        } else if (path.IsPrimPath()) {
+            InvalidateDescendants(path.GetParentPath());
+        }
+    }
+
+    // Remove the display information of the changed prims
+    if (_mustRebuildAll) {
+        _primInfos.clear();
+    } else {
+        for (const SdfPath &path : resyncedPaths) {
+            if (path.IsPrimPath()) {
+                auto it = _primInfos.lower_bound(path);
+                while (it != _primInfos.end() && it->first.HasPrefix(path)) {
+                    it = _primInfos.erase(it);
+                }
+            } else {
+                _primInfos.erase(path.GetPrimPath());
+            }
+        }
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        _primInfos.erase(path.GetPrimPath());
+    }
+}
+
+void StageOutlinerRows::Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions) {
+    if (!_stage || _stage != UsdStageWeakPtr(stage)) {
+        TfNotice::Revoke(_objectsChangedKey);
+        _stage = stage;
+        _objectsChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &StageOutlinerRows::OnObjectsChanged, _stage);
+        _mustRebuildAll = true;
+        // The infos of the previous stage can be at the same paths
+        _primInfos.clear();
+    }
+
+    // Past a certain number of invalidated branches, it is faster to traverse everything again
+    constexpr size_t maxInvalidatedPaths = 256;
+    if (!_mustRebuildAll && !_invalidatedPaths.empty()) {
+        SdfPath::RemoveDescendentPaths(&_invalidatedPaths);
+        _mustRebuildAll = _invalidatedPaths.size() > maxInvalidatedPaths;
+    }
+
+    if (!_mustRebuildAll && !_invalidatedPaths.empty()) {
+        SdfPathVector rebuiltPaths;
+        for (const SdfPath &invalidatedPath : _invalidatedPaths) {
+            // Rebuild from the closest row in the hierarchy, if the path is not displayed it is under a closed node
+            // or filtered out.
+            for (SdfPath path = invalidatedPath; !path.IsEmpty(); path = path.GetParentPath()) {
+                if (path.IsAbsoluteRootPath()) {
+                    _mustRebuildAll = true;
+                    break;
+                }
+                if (_rowIndices.count(path)) {
+                    rebuiltPaths.push_back(path);
+                    break;
+                }
+            }
+            if (_mustRebuildAll) {
+                break;
+            }
+        }
+        if (!_mustRebuildAll && !rebuiltPaths.empty()) {
+            // The rows are rebuilt from the last one, rebuilding a row doesn't move the previous rows
+            SdfPath::RemoveDescendentPaths(&rebuiltPaths);
+            std::vector<size_t> rowIndices;
+            for (const SdfPath &path : rebuiltPaths) {
+                rowIndices.push_back(_rowIndices[path]);
+            }
+            std::sort(rowIndices.rbegin(), rowIndices.rend());
+            for (const size_t rowIndex : rowIndices) {
+                RebuildDescendants(rowIndex, stage, displayOptions);
+            }
+            IndexRows();
+        }
+    }
+
+    if (_mustRebuildAll) {
+        RebuildAll(stage, displayOptions);
+        IndexRows();
+    }
+    _invalidatedPaths.clear();
+    _mustRebuildAll = false;
+}
+
+// Traverse the stage skipping the paths closed by the tree ui.
+void StageOutlinerRows::RebuildAll(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions) {
+    TRACE_FUNCTION();
+    _rows.clear();
+    if (!stage)
+        return;
+    ImGuiContext &g = *GImGui;
+    ImGuiWindow *window = g.CurrentWindow;
+    ImGuiStorage *storage = window->DC.StateStorage;
+    if (IsOpenedInTree(storage, SdfPath::AbsoluteRootPath())) {
+        // Stage
+        auto range = UsdPrimRange::Stage(stage, displayOptions.GetPrimFlagsPredicate());
+        TraverseRange(range, displayOptions.GetPrimFlagsPredicate(), _rows);
+        // Prototypes
+        if (displayOptions.GetShowPrototypes()) {
+            for (const auto &proto : stage->GetPrototypes()) {
+                auto range = UsdPrimRange(proto, displayOptions.GetPrimFlagsPredicate());
+                TraverseRange(range, displayOptions.GetPrimFlagsPredicate(), _rows);
+            }
+        }
+    }
+}
+
+// Replace the rows under rowIndex with a traversal of the opened descendants
+void StageOutlinerRows::RebuildDescendants(size_t rowIndex, const UsdStageRefPtr &stage,
+                                           const StageOutlinerDisplayOptions &displayOptions) {
+    ImGuiContext &g = *GImGui;
+    ImGuiWindow *window = g.CurrentWindow;
+    ImGuiStorage *storage = window->DC.StateStorage;
+    const SdfPath path = _rows[rowIndex].path;
+    auto first = _rows.begin() + rowIndex + 1;
+    auto last = std::find_if(first, _rows.end(), [&path](const StageOutlinerRow &row) { return !row.path.HasPrefix(path); });
+
+    const UsdPrim prim = stage->GetPrimAtPath(path);
+    if (!prim) {
+        // The prim doesn't exist anymore, the row is removed as well
+        _rows.erase(_rows.begin() + rowIndex, last);
+        return;
+    }
+    const auto &predicate = displayOptions.GetPrimFlagsPredicate();
+    const auto children = prim.GetFilteredChildren(predicate);
+    _rows[rowIndex].hasChildren = !children.empty();
+    std::vector<StageOutlinerRow> descendants;
+    if (_rows[rowIndex].hasChildren && IsOpenedInTree(storage, path)) {
+        for (const auto &child : children) {
+            auto range = UsdPrimRange(child, predicate);
+            TraverseRange(range, predicate, descendants);
+        }
+    }
+    first = _rows.erase(first, last);
+    _rows.insert(first, descendants.begin(), descendants.end());
+}
+
+void StageOutlinerRows::IndexRows() {
+    _rowIndices.clear();
+    _rowIndices.reserve(_rows.size());
+    for (size_t rowIndex = 0; rowIndex < _rows.size(); ++rowIndex) {
+        _rowIndices.emplace(_rows[rowIndex].path, rowIndex);
+    }
+}
+
+// Returns the paths of the rows from the anchor to the last path, the anchor first
+static SdfPathVector GetRowRange(const std::vector<StageOutlinerRow> &rows, const SdfPath &anchor, const SdfPath &last) {
+    const auto isAnchor = [&anchor](const StageOutlinerRow &row) { return row.path == anchor; };
+    const auto isLast = [&last](const StageOutlinerRow &row) { return row.path == last; };
+    const auto anchorRow = std::find_if(rows.begin(), rows.end(), isAnchor);
+    const auto lastRow = std::find_if(rows.begin(), rows.end(), isLast);
+    if (anchorRow == rows.end() || lastRow == rows.end()) {
+        return {last};
+    }
+    SdfPathVector paths;
+    const int step = anchorRow <= lastRow ? 1 : -1;
+    for (auto row = anchorRow; row != lastRow; row += step) {
+        paths.push_back(row->path);
+    }
+    paths.push_back(last);
+    return paths;
+}
+
+static void DrawPrimTreeRow(const UsdStageRefPtr &stage, const StageOutlinerRow &row, Selection &selectedPaths,
+                            StageOutlinerRows &rows) {
     ImGuiTreeNodeFlags flags =
         ImGuiTreeNodeFlags_OpenOnArrow |
         ImGuiTreeNodeFlags_AllowItemOverlap; // for testing worse case scenario add | ImGuiTreeNodeFlags_DefaultOpen;
 
-    // Another way ???
-    const auto &children = prim.GetFilteredChildren(displayOptions.GetPrimFlagsPredicate());
-    if (children.empty()) {
+    if (!row.hasChildren) {
         flags |= ImGuiTreeNodeFlags_Leaf;
     }
 
+    // Only the cached display information is read here, the prim is retrieved when it is edited
+    const SdfPath &path = row.path;
+    const StageOutlinerPrimInfo &primInfo = rows.GetPrimInfo(path);
+
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
-    DrawBackgroundSelection(prim, selectedPaths.IsSelected(prim.GetStage(), prim.GetPath()));
+    const bool selected = selectedPaths.IsSelected(stage, path);
+    const bool partiallySelected = !selected && row.hasChildren && !IsOpenedInTree(ImGui::GetStateStorage(), path) &&
+                                   selectedPaths.HasSelectedDescendant(stage, path);
+    DrawBackgroundSelection(selected, partiallySelected);
     bool unfolded = true;
     {
         {
-            TreeIndenter<StageOutlinerSeed, SdfPath> indenter(prim.GetPath());
-            ScopedStyleColor primColor(ImGuiCol_Text, GetPrimColor(prim), ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
-            const ImGuiID pathHash = IdOf(GetHash(prim.GetPath()));
+            TreeIndenter<StageOutlinerSeed, SdfPath> indenter(path);
+            ScopedStyleColor primColor(ImGuiCol_Text, GetPrimColor(primInfo), ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
+            const ImGuiID pathHash = IdOf(GetHash(path));
 
-            unfolded = ImGui::TreeNodeBehavior(pathHash, flags, prim.GetName().GetText());
+            unfolded = ImGui::TreeNodeBehavior(pathHash, flags, path.GetName().c_str());
+            if (ImGui::IsItemToggledOpen()) {
+                rows.InvalidateDescendants(path);
+            }
             // TreeSelectionBehavior(selectedPaths, &prim);
             if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
-                // TODO selection, should go in commands, ultimately the selection is passed
-                // as const
                 if (ImGui::IsKeyDown(ImGuiKey_LeftCtrl)) {
-                    if (selectedPaths.IsSelected(prim.GetStage(), prim.GetPath())) {
-                        selectedPaths.RemoveSelected(prim.GetStage(), prim.GetPath());
+                    if (selected) {
+                        ExecuteAfterDraw<EditorRemoveSelectedPaths>(stage, SdfPathVector{path});
                     } else {
-                        selectedPaths.AddSelected(prim.GetStage(), prim.GetPath());
+                        ExecuteAfterDraw<EditorAddSelectedPaths>(stage, SdfPathVector{path});
                     }
+                } else if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
+                    ExecuteAfterDraw<EditorSelectPaths>(stage,
+                                                        GetRowRange(rows.GetRows(), selectedPaths.GetAnchorPrimPath(stage), path));
                 } else {
-                    ExecuteAfterDraw<EditorSetSelection>(prim.GetStage(), prim.GetPath());
+                    ExecuteAfterDraw<EditorSetSelection>(stage, path);
                 }
             }
         }
         {
             ScopedStyleColor popupColor(ImGuiCol_Text, ImVec4(ColorPrimDefault));
             if (ImGui::BeginPopupContextItem()) {
-                DrawUsdPrimEditMenuItems(prim);
+                DrawUsdPrimEditMenuItems(stage->GetPrimAtPath(path));
+                ImGui::Separator();
+                if (ImGui::MenuItem("Select subtree")) {
+                    ExecuteAfterDraw<EditorAddSelectedSubtree>(stage, path);
+                }
+                if (ImGui::MenuItem("Deselect subtree")) {
+                    ExecuteAfterDraw<EditorRemoveSelectedSubtree>(stage, path);
+                }
+                if (ImGui::MenuItem("Invert selection of descendants")) {
+                    ExecuteAfterDraw<EditorInvertSelection>(stage, path);
+                }
                 ImGui::EndPopup();
             }
         }
         // Visibility
         ImGui::TableSetColumnIndex(1);
-        DrawVisibilityButton(prim);
+        DrawVisibilityButton(stage, path, primInfo, selectedPaths, selected);
 
         // Type
         ImGui::TableSetColumnIndex(2);
-        ImGui::Text("%s", prim.GetTypeName().GetText());
+        ImGui::Text("%s", primInfo.typeName.GetText());
     }
     if (unfolded) {
         ImGui::TreePop();
     }
 }
 
-static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths, StageOutlinerRows &rows) {
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
 
     ImGuiTreeNodeFlags nodeflags = ImGuiTreeNodeFlags_OpenOnArrow;
     std::string stageDisplayName(stage->GetRootLayer()->GetDisplayName());
     auto unfolded = ImGui::TreeNodeBehavior(IdOf(GetHash(SdfPath::AbsoluteRootPath())), nodeflags, stageDisplayName.c_str());
+    if (ImGui::IsItemToggledOpen()) {
+        rows.Invalidate();
+    }
 
     ImGui::TableSetColumnIndex(2);
     ImGui::SmallButton(ICON_FA_PEN);
@@ -306,76 +659,29 @@ static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPat
 }
 
 /// This function should be called only when the Selection has changed
-/// It modifies the internal imgui tree graph state.
-static void OpenSelectedPaths(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+/// It modifies the internal imgui tree graph state and invalidates the rows of the nodes it opens.
+static void OpenSelectedPaths(const UsdStageRefPtr &stage, Selection &selectedPaths, StageOutlinerRows &rows) {
     ImGuiContext &g = *GImGui;
     ImGuiWindow *window = g.CurrentWindow;
     ImGuiStorage *storage = window->DC.StateStorage;
-    for (const auto &path : selectedPaths.GetSelectedPaths(stage)) {
-        for (const auto &element : path.GetParentPath().GetPrefixes()) {
-            ImGuiID id = IdOf(GetHash(element)); // This has changed with the optim one
+    // Each ancestor of the selected paths is visited once
+    for (const auto &ancestor : selectedPaths.GetAncestorPaths(stage)) {
+        if (ancestor.IsAbsoluteRootPath())
+            continue;
+        ImGuiID id = IdOf(GetHash(ancestor)); // This has changed with the optim one
+        if (storage->GetInt(id, 0) == 0) {
             storage->SetInt(id, true);
+            rows.InvalidateDescendants(ancestor);
         }
     }
 }
 
-static void TraverseRange(UsdPrimRange &range, std::vector<SdfPath> &paths) {
-    static std::set<SdfPath> retainedPath; // to fix a bug with instanced prim which recreates the path at every call and give a different hash
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
-    for (auto iter = range.begin(); iter != range.end(); ++iter) {
-        const auto &path = iter->GetPath();
-        const ImGuiID pathHash = IdOf(GetHash(path));
-        const bool isOpen = storage->GetInt(pathHash, 0) != 0;
-        if (!isOpen) {
-            iter.PruneChildren();
-        }
-        // This bit of code is to avoid a bug. It appears that the SdfPath of instance proxies are not kept and the underlying memory
-        // is deleted and recreated between each frame, invalidating the hash value. So for the same path we have different hash every frame :s not cool.
-        // This problems appears on versions > 21.11
-        // a look at the changelog shows that they were lots of changes on the SdfPath side:
-        // https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
-        //
-        // In the end we workaround this issue by keeping the instance proxy paths alive:
-        if (iter->IsInstanceProxy()) {
-            retainedPath.insert(path);
-        }
-        paths.push_back(path);
-    }
-}
-
-// Traverse the stage skipping the paths closed by the tree ui.
-static void TraverseOpenedPaths(UsdStageRefPtr stage, std::vector<SdfPath> &paths, StageOutlinerDisplayOptions &displayOptions) {
-    if (!stage)
-        return;
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
-    paths.clear();
-    const SdfPath &rootPath = SdfPath::AbsoluteRootPath();
-    const bool rootPathIsOpen = storage->GetInt(IdOf(GetHash(rootPath)), 0) != 0;
-
-    if (rootPathIsOpen) {
-        // Stage
-        auto range = UsdPrimRange::Stage(stage, displayOptions.GetPrimFlagsPredicate());
-        TraverseRange(range, paths);
-        // Prototypes
-        if (displayOptions.GetShowPrototypes()) {
-            for(const auto &proto: stage->GetPrototypes()) {
-                auto range = UsdPrimRange(proto, displayOptions.GetPrimFlagsPredicate());
-                TraverseRange(range, paths);
-            }
-        }
-    }
-}
-
-static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const std::vector<SdfPath> &paths,
+static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const std::vector<StageOutlinerRow> &rows,
                                        ImGuiListClipper &clipper) {
     // linear search! it happens only when the selection has changed. We might want to maintain a map instead
     // if the hierarchies are big.
-    for (int i = 0; i < paths.size(); ++i) {
-        if (paths[i] == selectedPath) {
+    for (int i = 0; i < rows.size(); ++i) {
+        if (rows[i].path == selectedPath) {
             // scroll only if the item is not visible
             if (i < clipper.DisplayStart || i > clipper.DisplayEnd) {
                 ImGui::SetScrollY(clipper.ItemsHeight * i + 1);
@@ -385,38 +691,48 @@ static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const std::v
     }
 }
 
-void DrawStageOutlinerMenuBar(StageOutlinerDisplayOptions &displayOptions) {
-
+/// Returns true if the display options have changed
+bool DrawStageOutlinerMenuBar(StageOutlinerDisplayOptions &displayOptions) {
+    bool optionsChanged = false;
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("Show")) {
             if (ImGui::MenuItem("Inactive", nullptr, displayOptions.GetShowInactive())) {
                 displayOptions.ToggleShowInactive();
+                optionsChanged = true;
             }
             if (ImGui::MenuItem("Undefined", nullptr, displayOptions.GetShowUndefined())) {
                 displayOptions.ToggleShowUndefined();
+                optionsChanged = true;
             }
             if (ImGui::MenuItem("Unloaded", nullptr, displayOptions.GetShowUnloaded())) {
                 displayOptions.ToggleShowUnloaded();
+                optionsChanged = true;
             }
             if (ImGui::MenuItem("Abstract", nullptr, displayOptions.GetShowAbstract())) {
                 displayOptions.ToggleShowAbstract();
+                optionsChanged = true;
             }
             if (ImGui::MenuItem("Prototypes", nullptr, displayOptions.GetShowPrototypes())) {
                 displayOptions.ToggleShowPrototypes();
+                optionsChanged = true;
             }
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
     }
+    return optionsChanged;
 }
 
 /// Draw the hierarchy of the stage
-void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
+void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths, PrimQuery &query) {
     if (!stage)
         return;
     
     static StageOutlinerDisplayOptions displayOptions;
-    DrawStageOutlinerMenuBar(displayOptions);
+    static StageOutlinerRows rows;
+    if (DrawStageOutlinerMenuBar(displayOptions)) {
+        rows.Invalidate();
+    }
     
     //ImGui::PushID("StageOutliner");
     constexpr unsigned int textBufferSize = 512;
@@ -425,7 +741,20 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
     auto rootPrim = stage->GetPseudoRoot();
     auto layer = stage->GetSessionLayer();
 
-    static SelectionHash lastSelectionHash = 0;
+    // The selection is kept per stage, switching stages doesn't open the selected paths again. The stages are held
+    // weakly and the closed ones are forgotten, a stage allocated at the address of a closed one starts with no hash.
+    static std::vector<std::pair<UsdStageWeakPtr, SelectionHash>> lastSelectionHashes;
+    lastSelectionHashes.erase(std::remove_if(lastSelectionHashes.begin(), lastSelectionHashes.end(),
+                                             [](const std::pair<UsdStageWeakPtr, SelectionHash> &entry) { return !entry.first; }),
+                              lastSelectionHashes.end());
+    auto lastSelectionHash = std::find_if(lastSelectionHashes.begin(), lastSelectionHashes.end(),
+                                          [&stage](const std::pair<UsdStageWeakPtr, SelectionHash> &entry) {
+                                              return get_pointer(entry.first) == get_pointer(stage);
+                                          });
+    if (lastSelectionHash == lastSelectionHashes.end()) {
+        lastSelectionHashes.emplace_back(UsdStageWeakPtr(stage), SelectionHash());
+        lastSelectionHash = std::prev(lastSelectionHashes.end());
+    }
 
     ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
     ImVec2 tableOuterSize(0, currentWindow->Size[1] - 100); // TODO: set the correct size
@@ -437,19 +766,18 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
         ImGui::TableSetupColumn("Type");
 
         // Unfold the selected path
-        const bool selectionHasChanged = selectedPaths.UpdateSelectionHash(stage, lastSelectionHash);
+        const bool selectionHasChanged = selectedPaths.UpdateSelectionHash(stage, lastSelectionHash->second);
         if (selectionHasChanged) {            // We could use the imgui id as well instead of a static ??
-            OpenSelectedPaths(stage, selectedPaths); // Also we could have a UsdTweakFrame which contains all the changes that happened
+            OpenSelectedPaths(stage, selectedPaths, rows); // Also we could have a UsdTweakFrame which contains all the changes that happened
                                               // between the last frame and the new one
         }
 
-        // Find all the opened paths
-        std::vector<SdfPath> paths;
-        paths.reserve(1024);
-        TraverseOpenedPaths(stage, paths, displayOptions); // This must be inside the table scope to get the correct treenode hash table
+        // Update the opened paths
+        rows.Update(stage, displayOptions); // This must be inside the table scope to get the correct treenode hash table
+        const auto &paths = rows.GetRows();
 
         // Draw the tree root node, the layer
-        DrawStageTreeRow(stage, selectedPaths);
+        DrawStageTreeRow(stage, selectedPaths, rows);
 
         // Display only the visible paths with a clipper
         ImGuiListClipper clipper;
@@ -457,9 +785,7 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
         while (clipper.Step()) {
             for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
                 ImGui::PushID(row);
-                const SdfPath &path = paths[row];
-                const auto &prim = stage->GetPrimAtPath(path);
-                DrawPrimTreeRow(prim, selectedPaths, displayOptions);
+                DrawPrimTreeRow(stage, paths[row], selectedPaths, rows);
                 ImGui::PopID();
             }
         }
@@ -473,13 +799,59 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
 
     // Search prim bar
     static char patternBuffer[256];
-    static bool useRegex = false;
-    auto enterPressed = ImGui::InputTextWithHint("##SearchPrims", "Find prim", patternBuffer, 256, ImGuiInputTextFlags_EnterReturnsTrue);
+    const bool enterPressed =
+        ImGui::InputTextWithHint("##SearchPrims", "Find prim: name type:Mesh kind:component api:*API meta:instanceable=true",
+                                 patternBuffer, 256, ImGuiInputTextFlags_EnterReturnsTrue);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Terms: name, name:, type:, kind:, api:, attr:, meta:key[=value], path:\n"
+                          "Operators: and, or, not, ( )\nPatterns accept the * and ? wildcards");
+    }
+
+    // The search starts as the expression is typed and the results are streamed while it runs
+    const std::string expression(patternBuffer);
+    if (expression != query.GetExpression() || stage != query.GetStage()) {
+        query.Run(stage, expression);
+    }
+    static SdfPathVector matches;
+    static size_t matchesGeneration = 0;
+    if (query.GetGeneration() != matchesGeneration) {
+        matches.clear();
+        matchesGeneration = query.GetGeneration();
+    }
+    const size_t previousSize = matches.size();
+    query.FetchResults(matches);
+    if (matches.size() != previousSize) {
+        std::sort(matches.begin() + previousSize, matches.end());
+        std::inplace_merge(matches.begin(), matches.begin() + previousSize, matches.end());
+    }
+
     ImGui::SameLine();
-    ImGui::Checkbox("use regex", &useRegex);
+    if (ImGui::Button(ICON_FA_ARROW_UP)) {
+        ExecuteAfterDraw<EditorFindPrim>(true);
+    }
     ImGui::SameLine();
-    if (ImGui::Button("Select next") || enterPressed) {
-        ExecuteAfterDraw<EditorFindPrim>(std::string(patternBuffer), useRegex);
+    if (ImGui::Button(ICON_FA_ARROW_DOWN) || enterPressed) {
+        ExecuteAfterDraw<EditorFindPrim>(false);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Select all")) {
+        ExecuteAfterDraw<EditorSelectFoundPrims>();
+    }
+    ImGui::SameLine();
+    if (!query.GetError().empty()) {
+        ImGui::TextColored(ImVec4(ColorPrimUndefined), "%s", query.GetError().c_str());
+        return;
+    }
+    const auto anchor = std::lower_bound(matches.begin(), matches.end(), selectedPaths.GetAnchorPrimPath(stage));
+    if (anchor != matches.end() && *anchor == selectedPaths.GetAnchorPrimPath(stage)) {
+        ImGui::Text("%d/%zu matches", static_cast<int>(std::distance(matches.begin(), anchor)) + 1, matches.size());
+    } else {
+        ImGui::Text("%zu matches", matches.size());
+    }
+    if (query.IsRunning()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            query.Cancel();
+        }
     }
-
 }
@@ -4,5 +4,7 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+class PrimQuery;
+
 // TODO: selected could be multiple Path, we should pass a HdSelection instead
-void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths);
+void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths, PrimQuery &query);
@@ -2,37 +2,116 @@
 #include "Commands.h"
 #include "Gui.h"
 #include "ImGuiHelpers.h"
+#include "LayerTextExporter.h"
 
 // The following include contains the code which writes usd to text, but it's not
 // distributed with the api
 //#include <pxr/usd/sdf/fileIO_Common.h>
 
-void DrawTextEditor(SdfLayerRefPtr layer) {
-    static std::string layerText;
+// Draw only the visible lines of the exported text, the text of a big layer can have millions of lines
+static void DrawLayerTextLines(const LayerTextExporter &exporter, const ImVec2 &size) {
+    const std::string &text = exporter.GetText();
+    const std::vector<size_t> &lineOffsets = exporter.GetLineOffsets();
+    ScopedStyleColor color(ImGuiCol_ChildBg, ImVec4{0.0, 0.0, 0.0, 1.0});
+    if (ImGui::BeginChild("##TextLines", size, false, ImGuiWindowFlags_HorizontalScrollbar)) {
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(lineOffsets.size()));
+        while (clipper.Step()) {
+            for (int line = clipper.DisplayStart; line < clipper.DisplayEnd; ++line) {
+                const size_t nextLine = line + 1;
+                const size_t lineEnd = nextLine < lineOffsets.size() ? lineOffsets[nextLine] - 1 : text.size();
+                ImGui::TextUnformatted(text.c_str() + lineOffsets[line], text.c_str() + lineEnd);
+            }
+        }
+    }
+    ImGui::EndChild();
+}
+
+void DrawTextEditor(SdfLayerRefPtr layer, const SdfPath &selectedPrimPath, LayerTextExporter &exporter) {
+    // The text is copied for edition, it is applied when the edition ends
+    static std::string editedText;
+    static SdfLayerRefPtr editedLayer;
+    static SdfPath editedPrimPath;
+    static size_t editedGeneration = 0;
+    static bool showSelectedPrim = false;
     ImGuiIO &io = ImGui::GetIO();
     ImGuiWindow *window = ImGui::GetCurrentWindow();
     if (window->SkipItems) {
+        // The collapsed editor doesn't keep the layer and its text
+        exporter.SetLayer(nullptr);
         return;
     }
-    ImGui::Text("WARNING: this will slow down the application if the layer is big");
-    ImGui::Text("        and will consume lots of memory. Use with care for now");
+    // Without a selected prim nothing is exported, the whole layer can be too big to show
+    const bool isMissingSelectedPrim = showSelectedPrim && selectedPrimPath.IsEmpty();
+    exporter.SetLayer(isMissingSelectedPrim ? SdfLayerRefPtr() : layer);
+    exporter.SetPrimPath(showSelectedPrim ? selectedPrimPath : SdfPath());
+    exporter.Update();
+    // The edited text is dropped when the layer changes, applying it would revert the newer changes
+    if (editedLayer != layer || editedPrimPath != exporter.GetPrimPath() || editedGeneration != exporter.GetGeneration() ||
+        exporter.IsExporting()) {
+        editedLayer = nullptr;
+        editedText.clear();
+    }
     if (layer) {
-        layer->ExportToString(&layerText);
-        ImGui::Text("%s", layer->GetDisplayName().c_str());
+        ImGui::Checkbox("Selected prim only", &showSelectedPrim);
+        ImGui::SameLine();
+        if (isMissingSelectedPrim) {
+            ImGui::Text("%s", layer->GetDisplayName().c_str());
+            ImGui::SameLine();
+            ImGui::TextDisabled("(no prim selected)");
+        } else if (showSelectedPrim) {
+            ImGui::Text("%s %s", layer->GetDisplayName().c_str(), selectedPrimPath.GetText());
+        } else {
+            ImGui::Text("%s", layer->GetDisplayName().c_str());
+        }
+        if (exporter.IsExporting()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(exporting)");
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The export can't be interrupted, an edit of the layer waits for its end");
+            }
+        }
+        ImGui::SameLine();
+        if (!editedLayer && !isMissingSelectedPrim) {
+            // The text is outdated until the export ends
+            ImGui::BeginDisabled(exporter.IsExporting());
+            if (ImGui::Button("Edit")) {
+                editedText = exporter.GetText();
+                editedLayer = layer;
+                editedPrimPath = exporter.GetPrimPath();
+                editedGeneration = exporter.GetGeneration();
+            }
+            ImGui::EndDisabled();
+        } else if (editedLayer && ImGui::Button("Cancel")) {
+            editedLayer = nullptr;
+            editedText.clear();
+        }
     }
     ImGui::PushItemWidth(-FLT_MIN);
     ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
     ImVec2 sizeArg(0, currentWindow->Size[1] - 120);
     ImGui::PushFont(io.Fonts->Fonts[1]);
-    {
+    if (editedLayer) {
         ScopedStyleColor color(ImGuiCol_FrameBg, ImVec4{0.0, 0.0, 0.0, 1.0});
-        ImGui::InputTextMultiline("###TextEditor", &layerText, sizeArg,
+        ImGui::InputTextMultiline("###TextEditor", &editedText, sizeArg,
                                   ImGuiInputTextFlags_None | ImGuiInputTextFlags_NoUndoRedo);
-        if (layer && ImGui::IsItemDeactivatedAfterEdit()) {
-            ExecuteAfterDraw<LayerTextEdit>(layer, layerText);
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            if (editedPrimPath.IsEmpty()) {
+                ExecuteAfterDraw<LayerTextEdit>(layer, editedText);
+            } else {
+                ExecuteAfterDraw<LayerPrimTextEdit>(layer, editedPrimPath, editedText);
+            }
+            editedLayer = nullptr;
+            editedText.clear();
         }
+    } else {
+        DrawLayerTextLines(exporter, sizeArg);
     }
     ImGui::PopFont();
     ImGui::PopItemWidth();
-    ImGui::Text("Ctrl+Enter to apply your change");
+    if (editedLayer) {
+        ImGui::Text("Ctrl+Enter to apply your change");
+    } else {
+        ImGui::Text("Edit the selected prim only to avoid copying the whole text of a big layer");
+    }
 }
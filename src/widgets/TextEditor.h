@@ -4,4 +4,7 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
-void DrawTextEditor(SdfLayerRefPtr layer);
+class LayerTextExporter;
+
+/// Draw the text of the layer exported in the background, and edit it. The text can be limited to the selected prim.
+void DrawTextEditor(SdfLayerRefPtr layer, const SdfPath &selectedPrimPath, LayerTextExporter &exporter);
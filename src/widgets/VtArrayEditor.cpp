@@ -1,4 +1,5 @@
 #include "VtArrayEditor.h"
+#include "ArrayEdit.h"
 #include "Commands.h"
 #include "Gui.h"
 #include "VtValueEditor.h"
@@ -23,8 +24,8 @@ template <> int HeightOf<GfMatrix3f>() { return HeightOf<float>() * 3; }
 template <> int HeightOf<GfMatrix2d>() { return HeightOf<double>() * 2; }
 template <> int HeightOf<GfMatrix2f>() { return HeightOf<float>() * 2; }
 
-// Returns true if a modification happened
-template <typename ValueT> inline bool DrawVtArray(VtArray<ValueT> &values) {
+// Returns true if a modification happened, the array is not modified, the edit is returned instead
+template <typename ValueT> inline bool DrawVtArray(const VtArray<ValueT> &values, ArrayEdit &edit) {
     auto arraySize = values.size();
     bool addRow = ImGui::Button(ICON_FA_PLUS "##Add");
 
@@ -77,45 +78,43 @@ template <typename ValueT> inline bool DrawVtArray(VtArray<ValueT> &values) {
         ImGui::EndTable();
         // the actions need to happen after the clipper.Step() because it calls the draw code multiple times
         // to determine the size of the rows
-        if (newResult != VtValue()) {
-            values[rowToModify] = newResult.Get<ValueT>();
+        if (newResult.IsHolding<ValueT>()) {
+            edit = ArrayEdit{ArrayEdit::SetElement, static_cast<size_t>(rowToModify), 0, newResult};
             return true;
         } else if (deleteRow) {
-            values.erase(values.begin() + rowToModify);
+            edit = ArrayEdit{ArrayEdit::EraseElement, static_cast<size_t>(rowToModify), 0, VtValue()};
             return true;
         } else if (moveUp) {
             if (rowToModify > 0) {
-                std::swap(values[rowToModify], values[rowToModify - 1]);
+                edit = ArrayEdit{ArrayEdit::SwapElements, static_cast<size_t>(rowToModify), static_cast<size_t>(rowToModify - 1),
+                                 VtValue()};
                 return true;
             }
         } else if (moveDown) {
             if (rowToModify + 1 < values.size()) {
-                std::swap(values[rowToModify], values[rowToModify + 1]);
+                edit = ArrayEdit{ArrayEdit::SwapElements, static_cast<size_t>(rowToModify), static_cast<size_t>(rowToModify + 1),
+                                 VtValue()};
                 return true;
             }
         } else if (addRow) {
-            values.push_back(ValueT());
+            edit = ArrayEdit{ArrayEdit::InsertElement, values.size(), 0, VtValue(ValueT())};
             return true;
         }
     }
     return false;
 }
 
-template <typename ValueT> inline VtValue DrawVtValueArrayTyped(const VtValue &value) {
-    auto newArray = value.Get<VtArray<ValueT>>();
-    if (DrawVtArray<ValueT>(newArray))
-        return VtValue(newArray);
-    else
-        return VtValue();
+template <typename ValueT> inline bool DrawVtValueArrayTyped(const VtValue &value, ArrayEdit &edit) {
+    return DrawVtArray<ValueT>(value.UncheckedGet<VtArray<ValueT>>(), edit);
 }
 
 #define DrawArrayIfHolding(ValueT)                                                                                               \
     if (value.IsHolding<VtArray<ValueT>>()) {                                                                                    \
-        newValue = DrawVtValueArrayTyped<ValueT>(value);                                                                         \
+        edited = DrawVtValueArrayTyped<ValueT>(value, edit);                                                                     \
     } else
 
-VtValue DrawVtArrayValue(const VtValue &value) {
-    VtValue newValue;
+bool DrawVtArrayValue(const VtValue &value, ArrayEdit &edit) {
+    bool edited = false;
     if (value.IsArrayValued()) {
         // Ideally we would like to order the conditions test by the probablility
         // of appearance of the type
@@ -156,5 +155,5 @@ VtValue DrawVtArrayValue(const VtValue &value) {
         DrawArrayIfHolding(GfQuatd)
         {}
     }
-    return newValue;
+    return edited;
 }
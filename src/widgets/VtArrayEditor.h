@@ -6,4 +6,8 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
-VtValue DrawVtArrayValue(const VtValue &value);
+struct ArrayEdit;
+
+/// Draw the elements of an array value. Returns true if an element was edited, the edit is returned
+/// in edit instead of a modified copy of the array
+bool DrawVtArrayValue(const VtValue &value, ArrayEdit &edit);